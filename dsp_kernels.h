@@ -0,0 +1,863 @@
+// Block DSP kernels, built once per instruction set. main.c includes this
+// file several times, each time defining
+//   DSP_ISA     name of the build, appended to every function name here
+//   DSP_WIDTH   floats per SIMD step: 1 (scalar), 4, 8 or 16
+//   DSP_TARGET  target attribute for the functions, or nothing
+// and gets a `DspKernels dsp_kernels_<DSP_ISA>` table out of each pass.
+// Shared scalar and SIMD helpers (sinPoly4, wrapPhase8, ...) live in main.c.
+
+#if !defined(DSP_ISA) || !defined(DSP_WIDTH) || !defined(DSP_TARGET)
+#error "define DSP_ISA, DSP_WIDTH and DSP_TARGET before including dsp_kernels.h"
+#endif
+
+#define DSP_CONCAT_(a, b) a##_##b
+#define DSP_CONCAT(a, b) DSP_CONCAT_(a, b)
+#define DSP_FN(name) DSP_CONCAT(name, DSP_ISA)
+#define DSP_STRING_(x) #x
+#define DSP_STRING(x) DSP_STRING_(x)
+
+// out[t] = sinPoly(phase[t]), DSP_WIDTH samples per step.
+DSP_TARGET void DSP_FN(sinPolyBlock)(const float *phase, float *out,
+                                     size_t frames)
+{
+    size_t t = 0;
+#if DSP_WIDTH == 16
+    for (; t + 16 <= frames; t += 16)
+        _mm512_storeu_ps(out + t, sinPoly16(_mm512_loadu_ps(phase + t)));
+#elif DSP_WIDTH == 8
+    for (; t + 8 <= frames; t += 8)
+        _mm256_storeu_ps(out + t, sinPoly8(_mm256_loadu_ps(phase + t)));
+#elif DSP_WIDTH == 4
+    for (; t + 4 <= frames; t += 4)
+        _mm_storeu_ps(out + t, sinPoly4(_mm_loadu_ps(phase + t)));
+#endif
+    for (; t < frames; t++)
+        out[t] = sinPoly(phase[t]);
+}
+
+#define DEFINE_WAVE_KERNEL(kernel_name, shape_fn)                              \
+    DSP_TARGET void kernel_name(const float *phase, const float *phase_dt,     \
+                                float shape_parm, float *out, size_t frames)   \
+    {                                                                          \
+        for (size_t t = 0; t < frames; t++)                                    \
+            out[t] = shape_fn(phase[t], phase_dt[t], shape_parm);              \
+    }
+
+DEFINE_WAVE_KERNEL(DSP_FN(triKernel), triShape)
+
+// Saw and square at each AliasQuality. `quality` is a constant in every
+// caller (DEFINE_ALIAS_KERNELS), so each kernel keeps only its own ripple.
+DSP_TARGET static inline __attribute__((always_inline)) void
+DSP_FN(sawKernelImpl)(const float *phase, const float *phase_dt,
+                      float shape_parm, float *out, size_t frames,
+                      AliasQuality quality)
+{
+    size_t t = 0;
+#if DSP_WIDTH == 16
+    for (; t + 16 <= frames; t += 16)
+    {
+        __m512 p = _mm512_loadu_ps(phase + t);
+        __m512 dt = _mm512_loadu_ps(phase_dt + t);
+        __m512 ramp = _mm512_sub_ps(_mm512_mul_ps(p, _mm512_set1_ps(2.0f)),
+                                    _mm512_set1_ps(1.0f));
+        _mm512_storeu_ps(out + t,
+                         _mm512_sub_ps(ramp, aliasRipple16(p, dt, quality)));
+    }
+#elif DSP_WIDTH == 8
+    for (; t + 8 <= frames; t += 8)
+    {
+        __m256 p = _mm256_loadu_ps(phase + t);
+        __m256 dt = _mm256_loadu_ps(phase_dt + t);
+        __m256 ramp = _mm256_sub_ps(_mm256_mul_ps(p, _mm256_set1_ps(2.0f)),
+                                    _mm256_set1_ps(1.0f));
+        _mm256_storeu_ps(out + t,
+                         _mm256_sub_ps(ramp, aliasRipple8(p, dt, quality)));
+    }
+#elif DSP_WIDTH == 4
+    for (; t + 4 <= frames; t += 4)
+    {
+        __m128 p = _mm_loadu_ps(phase + t);
+        __m128 dt = _mm_loadu_ps(phase_dt + t);
+        __m128 ramp =
+            _mm_sub_ps(_mm_mul_ps(p, _mm_set1_ps(2.0f)), _mm_set1_ps(1.0f));
+        _mm_storeu_ps(out + t,
+                      _mm_sub_ps(ramp, aliasRipple4(p, dt, quality)));
+    }
+#endif
+    for (; t < frames; t++)
+        out[t] = sawShape(phase[t], phase_dt[t], shape_parm, quality);
+}
+
+DSP_TARGET static inline __attribute__((always_inline)) void
+DSP_FN(sqrKernelImpl)(const float *phase, const float *phase_dt,
+                      float shape_parm, float *out, size_t frames,
+                      AliasQuality quality)
+{
+    size_t t = 0;
+#if DSP_WIDTH == 16
+    const __m512 one = _mm512_set1_ps(1.0f);
+    const __m512 duty = _mm512_set1_ps(shape_parm);
+    for (; t + 16 <= frames; t += 16)
+    {
+        __m512 p = _mm512_loadu_ps(phase + t);
+        __m512 dt = _mm512_loadu_ps(phase_dt + t);
+        __mmask16 high = _mm512_cmp_ps_mask(p, duty, _CMP_LT_OQ);
+        __m512 sample = _mm512_mask_mov_ps(_mm512_set1_ps(-1.0f), high, one);
+        __m512 q = _mm512_add_ps(p, _mm512_sub_ps(one, duty));
+        q = _mm512_mask_sub_ps(q, _mm512_cmp_ps_mask(q, one, _CMP_GE_OQ), q,
+                               one);
+        sample = _mm512_add_ps(sample, aliasRipple16(p, dt, quality));
+        sample = _mm512_sub_ps(sample, aliasRipple16(q, dt, quality));
+        _mm512_storeu_ps(out + t, sample);
+    }
+#elif DSP_WIDTH == 8
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const __m256 duty = _mm256_set1_ps(shape_parm);
+    for (; t + 8 <= frames; t += 8)
+    {
+        __m256 p = _mm256_loadu_ps(phase + t);
+        __m256 dt = _mm256_loadu_ps(phase_dt + t);
+        __m256 high = _mm256_cmp_ps(p, duty, _CMP_LT_OQ);
+        __m256 sample = _mm256_blendv_ps(_mm256_set1_ps(-1.0f), one, high);
+        __m256 q = _mm256_add_ps(p, _mm256_sub_ps(one, duty));
+        q = _mm256_sub_ps(
+            q, _mm256_and_ps(_mm256_cmp_ps(q, one, _CMP_GE_OQ), one));
+        sample = _mm256_add_ps(sample, aliasRipple8(p, dt, quality));
+        sample = _mm256_sub_ps(sample, aliasRipple8(q, dt, quality));
+        _mm256_storeu_ps(out + t, sample);
+    }
+#elif DSP_WIDTH == 4
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 duty = _mm_set1_ps(shape_parm);
+    for (; t + 4 <= frames; t += 4)
+    {
+        __m128 p = _mm_loadu_ps(phase + t);
+        __m128 dt = _mm_loadu_ps(phase_dt + t);
+        __m128 high = _mm_cmplt_ps(p, duty);
+        __m128 sample = _mm_or_ps(_mm_and_ps(high, one),
+                                  _mm_andnot_ps(high, _mm_set1_ps(-1.0f)));
+        __m128 q = _mm_add_ps(p, _mm_sub_ps(one, duty));
+        q = _mm_sub_ps(q, _mm_and_ps(_mm_cmpge_ps(q, one), one));
+        sample = _mm_add_ps(sample, aliasRipple4(p, dt, quality));
+        sample = _mm_sub_ps(sample, aliasRipple4(q, dt, quality));
+        _mm_storeu_ps(out + t, sample);
+    }
+#endif
+    for (; t < frames; t++)
+        out[t] = sqrShape(phase[t], phase_dt[t], shape_parm, quality);
+}
+
+// <shape>Kernel is the PolyBLEP default; the other tiers get a suffix.
+#define DEFINE_ALIAS_KERNEL(kernel_name, impl, quality)                        \
+    DSP_TARGET void kernel_name(const float *phase, const float *phase_dt,     \
+                                float shape_parm, float *out, size_t frames)   \
+    {                                                                          \
+        impl(phase, phase_dt, shape_parm, out, frames, quality);               \
+    }
+#define DEFINE_ALIAS_KERNELS(shape)                                            \
+    DEFINE_ALIAS_KERNEL(DSP_FN(shape##NaiveKernel), DSP_FN(shape##KernelImpl), \
+                        AliasNaive)                                            \
+    DEFINE_ALIAS_KERNEL(DSP_FN(shape##Kernel), DSP_FN(shape##KernelImpl),      \
+                        AliasPolyBlep)                                         \
+    DEFINE_ALIAS_KERNEL(DSP_FN(shape##Blep4Kernel), DSP_FN(shape##KernelImpl), \
+                        AliasBlep4)
+
+DEFINE_ALIAS_KERNELS(saw)
+DEFINE_ALIAS_KERNELS(sqr)
+
+// Rounded square, 2 / (|s|^(s * sin) + 1) - 1 with s = 8 * shape_parm + 2.
+// shape_parm is constant over a slice, so the log is hoisted out and the
+// power becomes exp2(k * sin) with k = s * log2|s|.
+DSP_TARGET void DSP_FN(rsqKernel)(const float *phase, const float *phase_dt,
+                                  float shape_parm, float *out, size_t frames)
+{
+    const float s = (shape_parm * 8.0f) + 2.0f;
+    const float base = fabsf(s);
+    const float k = (base > 0.0f) ? s * log2f(base) : 0.0f;
+
+    DSP_FN(sinPolyBlock)(phase, out, frames);
+    size_t t = 0;
+#if DSP_WIDTH == 16
+    for (; t + 16 <= frames; t += 16)
+    {
+        __m512 x = _mm512_mul_ps(_mm512_set1_ps(k), _mm512_loadu_ps(out + t));
+        x = _mm512_min_ps(_mm512_max_ps(x, _mm512_set1_ps(-126.0f)),
+                          _mm512_set1_ps(126.0f));
+        __m512 d = _mm512_add_ps(exp2Fast16(x), _mm512_set1_ps(1.0f));
+        __m512 y = _mm512_div_ps(_mm512_set1_ps(2.0f), d);
+        _mm512_storeu_ps(out + t, _mm512_sub_ps(y, _mm512_set1_ps(1.0f)));
+    }
+#elif DSP_WIDTH == 8
+    for (; t + 8 <= frames; t += 8)
+    {
+        __m256 x = _mm256_mul_ps(_mm256_set1_ps(k), _mm256_loadu_ps(out + t));
+        x = _mm256_min_ps(_mm256_max_ps(x, _mm256_set1_ps(-126.0f)),
+                          _mm256_set1_ps(126.0f));
+        __m256 d = _mm256_add_ps(exp2Fast8(x), _mm256_set1_ps(1.0f));
+        __m256 y = _mm256_div_ps(_mm256_set1_ps(2.0f), d);
+        _mm256_storeu_ps(out + t, _mm256_sub_ps(y, _mm256_set1_ps(1.0f)));
+    }
+#elif DSP_WIDTH == 4
+    for (; t + 4 <= frames; t += 4)
+    {
+        __m128 x = _mm_mul_ps(_mm_set1_ps(k), _mm_loadu_ps(out + t));
+        x = _mm_min_ps(_mm_max_ps(x, _mm_set1_ps(-126.0f)),
+                       _mm_set1_ps(126.0f));
+        __m128 d = _mm_add_ps(exp2Fast4(x), _mm_set1_ps(1.0f));
+        __m128 y = _mm_div_ps(_mm_set1_ps(2.0f), d);
+        _mm_storeu_ps(out + t, _mm_sub_ps(y, _mm_set1_ps(1.0f)));
+    }
+#endif
+    for (; t < frames; t++)
+    {
+        float x = k * out[t];
+        x = (x > 126.0f) ? 126.0f : x;
+        x = (x < -126.0f) ? -126.0f : x;
+        out[t] = (2.0f / (exp2Fast(x) + 1.0f)) - 1.0f;
+    }
+}
+
+DSP_TARGET void DSP_FN(sinKernel)(const float *phase, const float *phase_dt,
+                                  float shape_parm, float *out, size_t frames)
+{
+    DSP_FN(sinPolyBlock)(phase, out, frames);
+}
+
+// Wavetable shape: shape_parm morphs from saw (0) to square (1).
+DSP_TARGET void DSP_FN(tblKernel)(const float *phase, const float *phase_dt,
+                                  float shape_parm, float *out, size_t frames)
+{
+    for (size_t t = 0; t < frames; t++)
+    {
+        const int level = waveTableLevel(phase_dt[t]);
+        const float *saw = wave_tables[WaveTableSaw][level];
+        const float *sqr = wave_tables[WaveTableSqr][level];
+
+        float pos = (phase[t] - floorFast(phase[t])) * WAVE_TABLE_SIZE;
+        int i = (int)pos;
+        float frac = pos - (float)i;
+        i &= WAVE_TABLE_SIZE - 1;
+
+        float a = saw[i] + frac * (saw[i + 1] - saw[i]);
+        float b = sqr[i] + frac * (sqr[i + 1] - sqr[i]);
+        out[t] = a + shape_parm * (b - a);
+    }
+}
+
+// Phase of a voice with a constant increment. Sample t is
+// wrap(phase0 + (t + 1) * phase_dt): no sample depends on the one before,
+// so a single voice fills SIMD lanes with consecutive samples. Leaves
+// `*phase` at the last sample.
+DSP_TARGET void DSP_FN(rampPhase)(float *phase, float phase_dt, float *ramp,
+                                  float *ramp_dt, size_t frames)
+{
+    const float phase0 = *phase;
+    size_t t = 0;
+#if DSP_WIDTH == 16
+    const __m512 steps = _mm512_setr_ps(1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12,
+                                        13, 14, 15, 16);
+    for (; t + 16 <= frames; t += 16)
+    {
+        __m512 k = _mm512_add_ps(_mm512_set1_ps((float)t), steps);
+        __m512 x = _mm512_add_ps(_mm512_set1_ps(phase0),
+                                 _mm512_mul_ps(k, _mm512_set1_ps(phase_dt)));
+        _mm512_storeu_ps(ramp + t, wrapPhase16(x));
+        _mm512_storeu_ps(ramp_dt + t, _mm512_set1_ps(phase_dt));
+    }
+#elif DSP_WIDTH == 8
+    const __m256 steps = _mm256_setr_ps(1, 2, 3, 4, 5, 6, 7, 8);
+    for (; t + 8 <= frames; t += 8)
+    {
+        __m256 k = _mm256_add_ps(_mm256_set1_ps((float)t), steps);
+        __m256 x = _mm256_add_ps(_mm256_set1_ps(phase0),
+                                 _mm256_mul_ps(k, _mm256_set1_ps(phase_dt)));
+        _mm256_storeu_ps(ramp + t, wrapPhase8(x));
+        _mm256_storeu_ps(ramp_dt + t, _mm256_set1_ps(phase_dt));
+    }
+#elif DSP_WIDTH == 4
+    const __m128 steps = _mm_setr_ps(1, 2, 3, 4);
+    for (; t + 4 <= frames; t += 4)
+    {
+        __m128 k = _mm_add_ps(_mm_set1_ps((float)t), steps);
+        __m128 x = _mm_add_ps(_mm_set1_ps(phase0),
+                              _mm_mul_ps(k, _mm_set1_ps(phase_dt)));
+        _mm_storeu_ps(ramp + t, wrapPhase4(x));
+        _mm_storeu_ps(ramp_dt + t, _mm_set1_ps(phase_dt));
+    }
+#endif
+    for (; t < frames; t++)
+    {
+        ramp[t] = wrapPhase(phase0 + (float)(t + 1) * phase_dt);
+        ramp_dt[t] = phase_dt;
+    }
+    if (frames > 0)
+        *phase = ramp[frames - 1];
+}
+
+// rampPhase on a fixed-point phase. Lane k starts at phase0 + (k + 1) * inc
+// and every step adds width * inc; integer adds are exact, so this matches
+// the serial accumulator bit for bit.
+DSP_TARGET void DSP_FN(rampPhaseFixed)(uint32_t *phase, uint32_t inc,
+                                       float phase_dt, float *ramp,
+                                       float *ramp_dt, size_t frames)
+{
+    const uint32_t phase0 = *phase;
+    size_t t = 0;
+#if DSP_WIDTH > 1
+    uint32_t start[DSP_WIDTH];
+    for (size_t k = 0; k < DSP_WIDTH; k++)
+        start[k] = phase0 + (uint32_t)(k + 1) * inc;
+    const uint32_t step = (uint32_t)DSP_WIDTH * inc;
+#endif
+#if DSP_WIDTH == 16
+    __m512i acc = _mm512_loadu_si512(start);
+    for (; t + 16 <= frames; t += 16)
+    {
+        _mm512_storeu_ps(ramp + t, fixedPhaseToFloat16(acc));
+        _mm512_storeu_ps(ramp_dt + t, _mm512_set1_ps(phase_dt));
+        acc = _mm512_add_epi32(acc, _mm512_set1_epi32((int)step));
+    }
+#elif DSP_WIDTH == 8
+    __m256i acc = _mm256_loadu_si256((const __m256i *)start);
+    for (; t + 8 <= frames; t += 8)
+    {
+        _mm256_storeu_ps(ramp + t, fixedPhaseToFloat8(acc));
+        _mm256_storeu_ps(ramp_dt + t, _mm256_set1_ps(phase_dt));
+        acc = _mm256_add_epi32(acc, _mm256_set1_epi32((int)step));
+    }
+#elif DSP_WIDTH == 4
+    __m128i acc = _mm_loadu_si128((const __m128i *)start);
+    for (; t + 4 <= frames; t += 4)
+    {
+        _mm_storeu_ps(ramp + t, fixedPhaseToFloat4(acc));
+        _mm_storeu_ps(ramp_dt + t, _mm_set1_ps(phase_dt));
+        acc = _mm_add_epi32(acc, _mm_set1_epi32((int)step));
+    }
+#endif
+    for (; t < frames; t++)
+    {
+        ramp[t] = fixedPhaseToFloat(phase0 + (uint32_t)(t + 1) * inc);
+        ramp_dt[t] = phase_dt;
+    }
+    *phase = phase0 + (uint32_t)frames * inc;
+}
+
+// Render one slice of a voice in three passes: the phase (a ramp, or the
+// recurrence when FM makes the increment vary), the waveform kernel (plus
+// the voice's pending edges for minBLEP), then amplitude, constant or ramped
+// to amp_target, times the voice's envelope. `frames` <= MAX_SLICE_SIZE; with
+// zero frames nothing runs and the voice keeps its state.
+// Only ever called with constant `kernel`, `is_fm` and `is_amp_ramp`, from
+// the renderers that DEFINE_VOICE_RENDERERS stamps out, so each copy keeps
+// just its own loops and calls its kernel directly.
+DSP_TARGET static inline __attribute__((always_inline)) void
+DSP_FN(renderVoiceImpl)(OscillatorArray *group, size_t slot,
+                        const float *mod_buf, float mod_ratio, size_t frames,
+                        int sample_rate, WaveKernelFn kernel, bool is_fm,
+                        bool is_amp_ramp)
+{
+    const float sample_duration = 1.0f / sample_rate;
+    const float freq = group->freq[slot];
+    if (frames == 0 || freq > (sample_rate / 2.0f) ||
+        freq < -(sample_rate / 2.0f))
+        return;
+
+    float phase[MAX_SLICE_SIZE];
+    float phase_dt[MAX_SLICE_SIZE];
+    if (!is_fm && group->is_fixed_phase)
+    {
+        group->phase_dt[slot] = freq * sample_duration;
+        DSP_FN(rampPhaseFixed)(&group->phase_acc[slot],
+                               phaseIncrement(group->phase_dt[slot]),
+                               group->phase_dt[slot], phase, phase_dt, frames);
+    }
+    else if (!is_fm)
+    {
+        group->phase_dt[slot] = freq * sample_duration;
+        DSP_FN(rampPhase)(&group->phase[slot], group->phase_dt[slot], phase,
+                          phase_dt, frames);
+    }
+    else if (group->is_fixed_phase)
+    {
+        for (size_t t = 0; t < frames; t++)
+        {
+            float dt = (freq + mod_buf[t] * mod_ratio) * sample_duration;
+            group->phase_acc[slot] += phaseIncrement(dt);
+            phase[t] = fixedPhaseToFloat(group->phase_acc[slot]);
+            phase_dt[t] = dt;
+        }
+        group->phase_dt[slot] = phase_dt[frames - 1];
+    }
+    else
+    {
+        for (size_t t = 0; t < frames; t++)
+        {
+            float freq_mod = mod_buf[t] * mod_ratio;
+            updatePhase(&group->phase[slot], &group->phase_dt[slot], freq,
+                        freq_mod, sample_duration);
+            phase[t] = group->phase[slot];
+            phase_dt[t] = group->phase_dt[slot];
+        }
+    }
+
+    float *buf = group->buf[slot];
+    const float(*env)[NUM_OSCILLATORS] = group->env_rows;
+    kernel(phase, phase_dt, group->shape_parm_0[slot], buf, frames);
+    if (isMinBlepVoice(group, slot))
+        applyMinBlep(group, slot, phase, phase_dt, buf, frames);
+
+    if (is_amp_ramp)
+    {
+        const float amp = group->amp[slot];
+        const float amp_step = (group->amp_target[slot] - amp) / frames;
+        for (size_t t = 0; t < frames; t++)
+            buf[t] *= (amp + amp_step * (float)(t + 1)) * env[t][slot];
+        group->amp[slot] = group->amp_target[slot];
+    }
+    else
+    {
+        const float amp = group->amp[slot];
+        for (size_t t = 0; t < frames; t++)
+            buf[t] *= amp * env[t][slot];
+    }
+}
+
+// Four renderers per shape: plain, amplitude ramp, FM, FM with ramp.
+#define DEFINE_VOICE_RENDERER(name, kernel, is_fm, is_amp_ramp)                \
+    DSP_TARGET void name(OscillatorArray *group, size_t slot,                  \
+                         const float *mod_buf, float mod_ratio, size_t frames, \
+                         int sample_rate)                                      \
+    {                                                                          \
+        DSP_FN(renderVoiceImpl)(group, slot, mod_buf, mod_ratio, frames,       \
+                                sample_rate, kernel, is_fm, is_amp_ramp);      \
+    }
+#define DEFINE_VOICE_RENDERERS(prefix)                                         \
+    DEFINE_VOICE_RENDERER(DSP_FN(prefix##Voice), DSP_FN(prefix##Kernel),       \
+                          false, false)                                        \
+    DEFINE_VOICE_RENDERER(DSP_FN(prefix##VoiceAmpRamp),                        \
+                          DSP_FN(prefix##Kernel), false, true)                 \
+    DEFINE_VOICE_RENDERER(DSP_FN(prefix##VoiceFm), DSP_FN(prefix##Kernel),     \
+                          true, false)                                         \
+    DEFINE_VOICE_RENDERER(DSP_FN(prefix##VoiceFmAmpRamp),                      \
+                          DSP_FN(prefix##Kernel), true, true)
+#define VOICE_RENDERER_TABLE(prefix)                                           \
+    {                                                                          \
+        {DSP_FN(prefix##Voice), DSP_FN(prefix##VoiceAmpRamp)},                 \
+        {                                                                      \
+            DSP_FN(prefix##VoiceFm), DSP_FN(prefix##VoiceFmAmpRamp)            \
+        }                                                                      \
+    }
+
+// Kernels and renderers by AliasQuality. Shapes without edges use the same
+// entry for every tier. MinBLEP renders the naive shape and renderVoiceImpl
+// adds the voice's pending edges.
+#define ALIAS_KERNEL_TABLE(shape)                                              \
+    {                                                                          \
+        [AliasNaive] = DSP_FN(shape##NaiveKernel),                             \
+        [AliasPolyBlep] = DSP_FN(shape##Kernel),                               \
+        [AliasBlep4] = DSP_FN(shape##Blep4Kernel),                             \
+        [AliasMinBlep] = DSP_FN(shape##NaiveKernel),                           \
+    }
+#define ALIAS_FREE_KERNEL_TABLE(shape)                                         \
+    {                                                                          \
+        DSP_FN(shape##Kernel), DSP_FN(shape##Kernel), DSP_FN(shape##Kernel),   \
+            DSP_FN(shape##Kernel)                                              \
+    }
+#define ALIAS_VOICE_RENDERER_TABLE(shape)                                      \
+    {                                                                          \
+        [AliasNaive] = VOICE_RENDERER_TABLE(shape##Naive),                     \
+        [AliasPolyBlep] = VOICE_RENDERER_TABLE(shape),                         \
+        [AliasBlep4] = VOICE_RENDERER_TABLE(shape##Blep4),                     \
+        [AliasMinBlep] = VOICE_RENDERER_TABLE(shape##Naive),                   \
+    }
+#define ALIAS_FREE_VOICE_RENDERER_TABLE(shape)                                 \
+    {                                                                          \
+        VOICE_RENDERER_TABLE(shape), VOICE_RENDERER_TABLE(shape),              \
+            VOICE_RENDERER_TABLE(shape), VOICE_RENDERER_TABLE(shape)           \
+    }
+
+DEFINE_VOICE_RENDERERS(sin)
+DEFINE_VOICE_RENDERERS(sawNaive)
+DEFINE_VOICE_RENDERERS(saw)
+DEFINE_VOICE_RENDERERS(sawBlep4)
+DEFINE_VOICE_RENDERERS(sqrNaive)
+DEFINE_VOICE_RENDERERS(sqr)
+DEFINE_VOICE_RENDERERS(sqrBlep4)
+DEFINE_VOICE_RENDERERS(tri)
+DEFINE_VOICE_RENDERERS(rsq)
+DEFINE_VOICE_RENDERERS(tbl)
+
+// rampPhase for `count` voices side by side, SIMD lanes across voices, into
+// row t of [frame][voice] matrices.
+DSP_TARGET void DSP_FN(rampPhaseLanes)(float *phase, const float *phase_dt,
+                                       size_t count, size_t frames,
+                                       float *phase_rows, float *phase_dt_rows)
+{
+    size_t v = 0;
+#if DSP_WIDTH == 16
+    for (; v + 16 <= count; v += 16)
+    {
+        const __m512 p0 = _mm512_loadu_ps(phase + v);
+        const __m512 dt = _mm512_loadu_ps(phase_dt + v);
+        for (size_t t = 0; t < frames; t++)
+        {
+            __m512 k = _mm512_set1_ps((float)(t + 1));
+            __m512 p = wrapPhase16(_mm512_add_ps(p0, _mm512_mul_ps(k, dt)));
+            _mm512_storeu_ps(phase_rows + t * count + v, p);
+            _mm512_storeu_ps(phase_dt_rows + t * count + v, dt);
+        }
+    }
+#elif DSP_WIDTH == 8
+    for (; v + 8 <= count; v += 8)
+    {
+        const __m256 p0 = _mm256_loadu_ps(phase + v);
+        const __m256 dt = _mm256_loadu_ps(phase_dt + v);
+        for (size_t t = 0; t < frames; t++)
+        {
+            __m256 k = _mm256_set1_ps((float)(t + 1));
+            __m256 p = wrapPhase8(_mm256_add_ps(p0, _mm256_mul_ps(k, dt)));
+            _mm256_storeu_ps(phase_rows + t * count + v, p);
+            _mm256_storeu_ps(phase_dt_rows + t * count + v, dt);
+        }
+    }
+#elif DSP_WIDTH == 4
+    for (; v + 4 <= count; v += 4)
+    {
+        const __m128 p0 = _mm_loadu_ps(phase + v);
+        const __m128 dt = _mm_loadu_ps(phase_dt + v);
+        for (size_t t = 0; t < frames; t++)
+        {
+            __m128 k = _mm_set1_ps((float)(t + 1));
+            __m128 p = wrapPhase4(_mm_add_ps(p0, _mm_mul_ps(k, dt)));
+            _mm_storeu_ps(phase_rows + t * count + v, p);
+            _mm_storeu_ps(phase_dt_rows + t * count + v, dt);
+        }
+    }
+#endif
+    for (; v < count; v++)
+    {
+        for (size_t t = 0; t < frames; t++)
+        {
+            phase_rows[t * count + v] =
+                wrapPhase(phase[v] + (float)(t + 1) * phase_dt[v]);
+            phase_dt_rows[t * count + v] = phase_dt[v];
+        }
+    }
+
+    if (frames > 0)
+        memcpy(phase, phase_rows + (frames - 1) * count,
+               count * sizeof(float));
+}
+
+// rampPhaseLanes on fixed-point phases.
+DSP_TARGET void DSP_FN(rampPhaseLanesFixed)(uint32_t *phase,
+                                            const uint32_t *inc,
+                                            const float *phase_dt, size_t count,
+                                            size_t frames, float *phase_rows,
+                                            float *phase_dt_rows)
+{
+    size_t v = 0;
+#if DSP_WIDTH == 16
+    for (; v + 16 <= count; v += 16)
+    {
+        __m512i acc = _mm512_loadu_si512(phase + v);
+        const __m512i step = _mm512_loadu_si512(inc + v);
+        const __m512 dt = _mm512_loadu_ps(phase_dt + v);
+        for (size_t t = 0; t < frames; t++)
+        {
+            acc = _mm512_add_epi32(acc, step);
+            _mm512_storeu_ps(phase_rows + t * count + v,
+                             fixedPhaseToFloat16(acc));
+            _mm512_storeu_ps(phase_dt_rows + t * count + v, dt);
+        }
+        _mm512_storeu_si512(phase + v, acc);
+    }
+#elif DSP_WIDTH == 8
+    for (; v + 8 <= count; v += 8)
+    {
+        __m256i acc = _mm256_loadu_si256((const __m256i *)(phase + v));
+        const __m256i step = _mm256_loadu_si256((const __m256i *)(inc + v));
+        const __m256 dt = _mm256_loadu_ps(phase_dt + v);
+        for (size_t t = 0; t < frames; t++)
+        {
+            acc = _mm256_add_epi32(acc, step);
+            _mm256_storeu_ps(phase_rows + t * count + v,
+                             fixedPhaseToFloat8(acc));
+            _mm256_storeu_ps(phase_dt_rows + t * count + v, dt);
+        }
+        _mm256_storeu_si256((__m256i *)(phase + v), acc);
+    }
+#elif DSP_WIDTH == 4
+    for (; v + 4 <= count; v += 4)
+    {
+        __m128i acc = _mm_loadu_si128((const __m128i *)(phase + v));
+        const __m128i step = _mm_loadu_si128((const __m128i *)(inc + v));
+        const __m128 dt = _mm_loadu_ps(phase_dt + v);
+        for (size_t t = 0; t < frames; t++)
+        {
+            acc = _mm_add_epi32(acc, step);
+            _mm_storeu_ps(phase_rows + t * count + v, fixedPhaseToFloat4(acc));
+            _mm_storeu_ps(phase_dt_rows + t * count + v, dt);
+        }
+        _mm_storeu_si128((__m128i *)(phase + v), acc);
+    }
+#endif
+    for (; v < count; v++)
+    {
+        for (size_t t = 0; t < frames; t++)
+        {
+            phase[v] += inc[v];
+            phase_rows[t * count + v] = fixedPhaseToFloat(phase[v]);
+            phase_dt_rows[t * count + v] = phase_dt[v];
+        }
+    }
+}
+
+// Render `count` unmodulated voices from slot `first` in lockstep, SIMD lanes
+// across voices for the phase ramp. The voices share shape_parm, so
+// one kernel call covers the whole [frame][voice] matrix, which is then
+// scattered to the voice buffers. Same arithmetic as renderVoice, voice for
+// voice.
+DSP_TARGET void DSP_FN(renderVoiceBatch)(OscillatorArray *group, size_t first,
+                                         size_t count, size_t frames,
+                                         int sample_rate)
+{
+    if (frames == 0 || count == 0)
+        return;
+    const float sample_duration = 1.0f / sample_rate;
+    float *phase_dt = group->phase_dt + first;
+    for (size_t v = 0; v < count; v++)
+        phase_dt[v] = group->freq[first + v] * sample_duration;
+
+    float phase_rows[MAX_SLICE_SIZE * NUM_OSCILLATORS];
+    float phase_dt_rows[MAX_SLICE_SIZE * NUM_OSCILLATORS];
+    float out_rows[MAX_SLICE_SIZE * NUM_OSCILLATORS];
+    if (group->is_fixed_phase)
+    {
+        uint32_t inc[NUM_OSCILLATORS];
+        for (size_t v = 0; v < count; v++)
+            inc[v] = phaseIncrement(phase_dt[v]);
+        DSP_FN(rampPhaseLanesFixed)(group->phase_acc + first, inc, phase_dt,
+                                    count, frames, phase_rows, phase_dt_rows);
+    }
+    else
+    {
+        DSP_FN(rampPhaseLanes)(group->phase + first, phase_dt, count, frames,
+                               phase_rows, phase_dt_rows);
+    }
+    group->dsp->wave[group->shape][group->alias_quality[first]](
+        phase_rows, phase_dt_rows, group->shape_parm_0[first], out_rows,
+        frames * count);
+
+    // Amplitude times envelope, row by row: env_rows has the same [frame]
+    // [voice] layout as out_rows.
+    const float *amp = group->amp + first;
+    for (size_t t = 0; t < frames; t++)
+    {
+        float *row = out_rows + t * count;
+        const float *env = group->env_rows[t] + first;
+        size_t v = 0;
+#if DSP_WIDTH == 16
+        for (; v + 16 <= count; v += 16)
+            _mm512_storeu_ps(
+                row + v,
+                _mm512_mul_ps(_mm512_loadu_ps(row + v),
+                              _mm512_mul_ps(_mm512_loadu_ps(amp + v),
+                                            _mm512_loadu_ps(env + v))));
+#elif DSP_WIDTH == 8
+        for (; v + 8 <= count; v += 8)
+            _mm256_storeu_ps(
+                row + v,
+                _mm256_mul_ps(_mm256_loadu_ps(row + v),
+                              _mm256_mul_ps(_mm256_loadu_ps(amp + v),
+                                            _mm256_loadu_ps(env + v))));
+#elif DSP_WIDTH == 4
+        for (; v + 4 <= count; v += 4)
+            _mm_storeu_ps(row + v,
+                          _mm_mul_ps(_mm_loadu_ps(row + v),
+                                     _mm_mul_ps(_mm_loadu_ps(amp + v),
+                                                _mm_loadu_ps(env + v))));
+#endif
+        for (; v < count; v++)
+            row[v] *= amp[v] * env[v];
+    }
+
+    for (size_t v = 0; v < count; v++)
+    {
+        float *buf = group->buf[first + v];
+        for (size_t t = 0; t < frames; t++)
+            buf[t] = out_rows[t * count + v];
+    }
+}
+
+// Step the envelope of every voice of `group` through `frames` samples into
+// env_rows, SIMD lanes across voices. Lanes whose segment reaches its goal are
+// finished in scalar code and reloaded, which happens a few times per note.
+// Runs of voices that all sustain just repeat their level.
+DSP_TARGET void DSP_FN(renderEnvelopes)(OscillatorArray *group, size_t frames)
+{
+    size_t v = 0;
+#if DSP_WIDTH == 16
+    for (; v + 16 <= group->count; v += 16)
+    {
+        __m512 env = _mm512_loadu_ps(group->env + v);
+        if (isEnvelopeHeld(group, v, 16))
+        {
+            for (size_t t = 0; t < frames; t++)
+                _mm512_storeu_ps(group->env_rows[t] + v, env);
+            continue;
+        }
+        __m512 dist = _mm512_loadu_ps(group->env_dist + v);
+        __m512 mul = _mm512_loadu_ps(group->env_mul + v);
+        __m512 aim = _mm512_loadu_ps(group->env_aim + v);
+        __m512 end = _mm512_loadu_ps(group->env_end + v);
+        __m512 dir = _mm512_loadu_ps(group->env_dir + v);
+        for (size_t t = 0; t < frames; t++)
+        {
+            dist = _mm512_mul_ps(dist, mul);
+            unsigned done = _mm512_cmp_ps_mask(
+                _mm512_mul_ps(_mm512_sub_ps(dist, end), dir),
+                _mm512_setzero_ps(), _CMP_GE_OQ);
+            if (done != 0)
+            {
+                _mm512_storeu_ps(group->env_dist + v, dist);
+                for (; done != 0; done &= done - 1)
+                    finishEnvStage(group, v + __builtin_ctz(done));
+                dist = _mm512_loadu_ps(group->env_dist + v);
+                mul = _mm512_loadu_ps(group->env_mul + v);
+                aim = _mm512_loadu_ps(group->env_aim + v);
+                end = _mm512_loadu_ps(group->env_end + v);
+                dir = _mm512_loadu_ps(group->env_dir + v);
+            }
+            env = _mm512_add_ps(dist, aim);
+            _mm512_storeu_ps(group->env_rows[t] + v, env);
+        }
+        _mm512_storeu_ps(group->env_dist + v, dist);
+        _mm512_storeu_ps(group->env + v, env);
+    }
+#elif DSP_WIDTH == 8
+    for (; v + 8 <= group->count; v += 8)
+    {
+        __m256 env = _mm256_loadu_ps(group->env + v);
+        if (isEnvelopeHeld(group, v, 8))
+        {
+            for (size_t t = 0; t < frames; t++)
+                _mm256_storeu_ps(group->env_rows[t] + v, env);
+            continue;
+        }
+        __m256 dist = _mm256_loadu_ps(group->env_dist + v);
+        __m256 mul = _mm256_loadu_ps(group->env_mul + v);
+        __m256 aim = _mm256_loadu_ps(group->env_aim + v);
+        __m256 end = _mm256_loadu_ps(group->env_end + v);
+        __m256 dir = _mm256_loadu_ps(group->env_dir + v);
+        for (size_t t = 0; t < frames; t++)
+        {
+            dist = _mm256_mul_ps(dist, mul);
+            unsigned done = (unsigned)_mm256_movemask_ps(_mm256_cmp_ps(
+                _mm256_mul_ps(_mm256_sub_ps(dist, end), dir),
+                _mm256_setzero_ps(), _CMP_GE_OQ));
+            if (done != 0)
+            {
+                _mm256_storeu_ps(group->env_dist + v, dist);
+                for (; done != 0; done &= done - 1)
+                    finishEnvStage(group, v + __builtin_ctz(done));
+                dist = _mm256_loadu_ps(group->env_dist + v);
+                mul = _mm256_loadu_ps(group->env_mul + v);
+                aim = _mm256_loadu_ps(group->env_aim + v);
+                end = _mm256_loadu_ps(group->env_end + v);
+                dir = _mm256_loadu_ps(group->env_dir + v);
+            }
+            env = _mm256_add_ps(dist, aim);
+            _mm256_storeu_ps(group->env_rows[t] + v, env);
+        }
+        _mm256_storeu_ps(group->env_dist + v, dist);
+        _mm256_storeu_ps(group->env + v, env);
+    }
+#elif DSP_WIDTH == 4
+    for (; v + 4 <= group->count; v += 4)
+    {
+        __m128 env = _mm_loadu_ps(group->env + v);
+        if (isEnvelopeHeld(group, v, 4))
+        {
+            for (size_t t = 0; t < frames; t++)
+                _mm_storeu_ps(group->env_rows[t] + v, env);
+            continue;
+        }
+        __m128 dist = _mm_loadu_ps(group->env_dist + v);
+        __m128 mul = _mm_loadu_ps(group->env_mul + v);
+        __m128 aim = _mm_loadu_ps(group->env_aim + v);
+        __m128 end = _mm_loadu_ps(group->env_end + v);
+        __m128 dir = _mm_loadu_ps(group->env_dir + v);
+        for (size_t t = 0; t < frames; t++)
+        {
+            dist = _mm_mul_ps(dist, mul);
+            unsigned done = (unsigned)_mm_movemask_ps(_mm_cmpge_ps(
+                _mm_mul_ps(_mm_sub_ps(dist, end), dir), _mm_setzero_ps()));
+            if (done != 0)
+            {
+                _mm_storeu_ps(group->env_dist + v, dist);
+                for (; done != 0; done &= done - 1)
+                    finishEnvStage(group, v + __builtin_ctz(done));
+                dist = _mm_loadu_ps(group->env_dist + v);
+                mul = _mm_loadu_ps(group->env_mul + v);
+                aim = _mm_loadu_ps(group->env_aim + v);
+                end = _mm_loadu_ps(group->env_end + v);
+                dir = _mm_loadu_ps(group->env_dir + v);
+            }
+            env = _mm_add_ps(dist, aim);
+            _mm_storeu_ps(group->env_rows[t] + v, env);
+        }
+        _mm_storeu_ps(group->env_dist + v, dist);
+        _mm_storeu_ps(group->env + v, env);
+    }
+#endif
+    for (; v < group->count; v++)
+        stepEnvelope(group, v, frames);
+}
+
+// signal[t] += buf[t]: one voice into the mix bus.
+DSP_TARGET void DSP_FN(mixBuffer)(float *signal, const float *buf,
+                                  size_t frames)
+{
+    size_t t = 0;
+#if DSP_WIDTH == 16
+    for (; t + 16 <= frames; t += 16)
+        _mm512_storeu_ps(signal + t, _mm512_add_ps(_mm512_loadu_ps(signal + t),
+                                                   _mm512_loadu_ps(buf + t)));
+#elif DSP_WIDTH == 8
+    for (; t + 8 <= frames; t += 8)
+        _mm256_storeu_ps(signal + t, _mm256_add_ps(_mm256_loadu_ps(signal + t),
+                                                   _mm256_loadu_ps(buf + t)));
+#elif DSP_WIDTH == 4
+    for (; t + 4 <= frames; t += 4)
+        _mm_storeu_ps(signal + t, _mm_add_ps(_mm_loadu_ps(signal + t),
+                                             _mm_loadu_ps(buf + t)));
+#endif
+    for (; t < frames; t++)
+        signal[t] += buf[t];
+}
+
+const DspKernels DSP_FN(dsp_kernels) = {
+    .name = DSP_STRING(DSP_ISA),
+    .wave =
+        {
+            [WaveSin] = ALIAS_FREE_KERNEL_TABLE(sin),
+            [WaveSaw] = ALIAS_KERNEL_TABLE(saw),
+            [WaveSqr] = ALIAS_KERNEL_TABLE(sqr),
+            [WaveTri] = ALIAS_FREE_KERNEL_TABLE(tri),
+            [WaveRsq] = ALIAS_FREE_KERNEL_TABLE(rsq),
+            [WaveTbl] = ALIAS_FREE_KERNEL_TABLE(tbl),
+        },
+    .voice =
+        {
+            [WaveSin] = ALIAS_FREE_VOICE_RENDERER_TABLE(sin),
+            [WaveSaw] = ALIAS_VOICE_RENDERER_TABLE(saw),
+            [WaveSqr] = ALIAS_VOICE_RENDERER_TABLE(sqr),
+            [WaveTri] = ALIAS_FREE_VOICE_RENDERER_TABLE(tri),
+            [WaveRsq] = ALIAS_FREE_VOICE_RENDERER_TABLE(rsq),
+            [WaveTbl] = ALIAS_FREE_VOICE_RENDERER_TABLE(tbl),
+        },
+    .render_batch = DSP_FN(renderVoiceBatch),
+    .mix = DSP_FN(mixBuffer),
+    .envelopes = DSP_FN(renderEnvelopes),
+};
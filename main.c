@@ -1,9 +1,20 @@
+#include <errno.h>
 #include <math.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
 
 #define RAYGUI_IMPLEMENTATION
 #include "raygui.h"
@@ -12,12 +23,42 @@
 #define SCREEN_WIDTH 1200
 #define SCREEN_HEIGHT 700
 
-#define SAMPLE_RATE 44100
-#define SAMPLE_DURATION (1.0f / SAMPLE_RATE)
-#define STREAM_BUFFER_SIZE 1024
+#define DEFAULT_SAMPLE_RATE 44100
+#define DEFAULT_BLOCK_SIZE 1024
+#define MIN_BLOCK_SIZE 16
+#define MAX_BLOCK_SIZE 4096
+#define DEFAULT_SLICE_SIZE 32
+#define MAX_SLICE_SIZE 64
 #define NUM_OSCILLATORS 32
 #define MAX_UI_OSC 32
 #define BASE_NOTE_FREQ 440
+#define MIDI_NOTE_COUNT 128
+#define MAX_HELD_NOTES 128
+#define ENV_MAX_SECONDS 4.0f
+#define ENV_DEFAULT_ATTACK 0.005f
+#define ENV_DEFAULT_DECAY 0.1f
+#define ENV_DEFAULT_SUSTAIN 1.0f
+#define ENV_DEFAULT_RELEASE 0.05f
+#define DEFAULT_POLYPHONY 32
+#define STEAL_FADE_SECONDS 0.003f // anti-click fade of a stolen voice
+#define DEFAULT_CULL_DB -96.0f
+#define ENV_ATTACK_OVERSHOOT 0.3f  // attack aims 30% of its span past 1
+#define ENV_DECAY_UNDERSHOOT 1e-4f // decay and release, as a fraction
+#define EVENT_QUEUE_CAPACITY 1024 // must be a power of two
+#define CACHE_LINE_SIZE 64
+#define RENDER_MAX_TAIL_SECONDS 60.0f // cap on releases after the last note
+#define RT_STACK_PREFAULT_SIZE (64 * 1024)
+#define RT_FIFO_PRIORITY 70
+#define MAX_RENDER_THREADS 16
+#define JOB_DEQUE_CAPACITY 256 // power of two, > MAX_VOICES
+#define PARALLEL_MIN_VOICES 8
+#define VOICE_BATCH_MIN 4
+#define SPINS_BEFORE_YIELD 64
+#define STATS_WINDOW 256 // blocks in the rolling min/avg/p99/max
+#define STATS_HISTOGRAM_BINS 21 // 5% of the deadline each, last is >= 100%
+#define AUDIO_STREAM_BUFFERS 2  // raylib double-buffers every stream
+#define SCOPE_SAMPLES 1024
+#define SCOPE_READ_ATTEMPTS 3
 
 #define LEFT_PANEL_WIDTH (SCREEN_WIDTH / 4.0f)
 
@@ -25,7 +66,10 @@
 
 ////////////////////////////////////////////////////////////////
 
-#define WAVE_SHAPE_OPTIONS "sine;sawtooth;square;triangle;rounded square"
+#define WAVE_SHAPE_OPTIONS                                                     \
+    "sine;sawtooth;square;triangle;rounded square;wavetable"
+// Short names accepted in patch files, in WaveShape order.
+const char *WAVE_SHAPE_NAMES[] = {"sin", "saw", "sqr", "tri", "rsq", "tbl"};
 typedef enum WaveShape
 {
     WaveSin = 0,
@@ -33,69 +77,490 @@ typedef enum WaveShape
     WaveSqr = 2,
     WaveTri = 3,
     WaveRsq = 4,
+    WaveTbl = 5,
     WaveCount
 } WaveShape;
 
+#define MAX_VOICES (WaveCount * NUM_OSCILLATORS)
+
+// How saw and square edges are band-limited, cheapest first. The other shapes
+// have no jumps to correct; tbl is band-limited by construction.
+#define ALIAS_QUALITY_OPTIONS "naive;blep;blep4;minblep"
+const char *ALIAS_QUALITY_NAMES[] = {"naive", "blep", "blep4", "minblep"};
+typedef enum AliasQuality
+{
+    AliasNaive = 0,    // raw jumps
+    AliasPolyBlep = 1, // 2-point polynomial BLEP, the default
+    AliasBlep4 = 2,    // 4-point BLEP from the integrated cubic B-spline
+    AliasMinBlep = 3,  // minimum-phase BLEP table, causal
+    AliasQualityCount
+} AliasQuality;
+
+// MinBLEP table geometry; see initMinBlepTable. MIN_BLEP_SAMPLES is a power of
+// two, the length of each voice's ring of pending corrections.
+#define MIN_BLEP_ZERO_CROSSINGS 16
+#define MIN_BLEP_CUTOFF 0.8 // of Nyquist, leaving room for the transition band
+#define MIN_BLEP_OVERSAMPLING 64
+#define MIN_BLEP_SAMPLES (2 * MIN_BLEP_ZERO_CROSSINGS)
+#define MIN_BLEP_SIZE (MIN_BLEP_SAMPLES * MIN_BLEP_OVERSAMPLING)
+#define MIN_BLEP_FFT_SIZE (4 * MIN_BLEP_SIZE)
+
+// Which sounding note gives up its voices when a new one would exceed the
+// polyphony limit.
+const char *STEAL_POLICY_NAMES[] = {"release", "oldest", "quietest", "same"};
+typedef enum StealPolicy
+{
+    StealRelease = 0, // a released note if any, else the oldest; the default
+    StealOldest = 1,
+    StealQuietest = 2, // lowest amplitude times envelope right now
+    StealSameNote = 3, // retrigger a sounding note of the same key, else oldest
+    StealPolicyCount
+} StealPolicy;
+
 typedef struct UIOsc
 {
     float freq;
     float amp;
     float shape_parm_0;
+    float attack;  // seconds
+    float decay;   // seconds
+    float sustain; // level, 0 to 1
+    float release; // seconds
     WaveShape shape;
+    AliasQuality alias_quality;
     bool is_dropdown_open;
+    bool is_alias_dropdown_open;
     bool is_kb_enabled;
     Rectangle shape_dropdown_rect;
+    Rectangle alias_dropdown_rect;
     int mod_state;
 } UIOsc;
 
-typedef struct Oscillator
-{
-    float phase;
-    float phase_dt;
-    float freq;
-    float amp;
-    float shape_parm_0;
-    float buf[STREAM_BUFFER_SIZE];
-    bool is_mod;
-    size_t ui_id;
-} Oscillator;
+// Fills `frames` samples of one waveform from per-sample phase and phase
+// increment. Kernels are plain loops over inlined per-sample shapes, so the
+// compiler can unroll and vectorize them.
+typedef void (*WaveKernelFn)(const float *phase, const float *phase_dt,
+                             float shape_parm, float *out, size_t frames);
 
-typedef float (*WaveShapeFn)(const float phase, const float phase_dt,
-                             const float shape_parm);
+// ADSR stages. Each of attack, decay and release is one exponential segment
+// that aims past its goal, so it gets there in finite time: env = env * mul +
+// add, per sample, until (env - goal) * dir >= 0.
+typedef enum EnvStage
+{
+    EnvAttack = 0,
+    EnvDecay = 1,
+    EnvSustain = 2,
+    EnvRelease = 3,
+    EnvFade = 4, // stolen: a short release that ignores the patch
+    EnvOff = 5,  // release finished; the voice is retired after the slice
+} EnvStage;
 
+// Voices of one shape, stored as parallel arrays so that neighbouring voices
+// can share SIMD lanes. Slots [0, count) are live, sorted by ui_id and then by
+// note age. A voice is named by group * NUM_OSCILLATORS + slot; when voices
+// shift to open or close a slot, their state and buffers move with them.
 typedef struct OscillatorArray
 {
-    Oscillator osc[NUM_OSCILLATORS];
+    float phase[NUM_OSCILLATORS];
+    uint32_t phase_acc[NUM_OSCILLATORS]; // replaces `phase` if is_fixed_phase
+    float phase_dt[NUM_OSCILLATORS];
+    float freq[NUM_OSCILLATORS];
+    float amp[NUM_OSCILLATORS];
+    float amp_target[NUM_OSCILLATORS]; // amp ramps here over the next slice
+    float shape_parm_0[NUM_OSCILLATORS];
+    AliasQuality alias_quality[NUM_OSCILLATORS];
+    // MinBLEP corrections owed to the next samples, a ring from min_blep_pos.
+    float min_blep_pending[NUM_OSCILLATORS][MIN_BLEP_SAMPLES];
+    size_t min_blep_pos[NUM_OSCILLATORS];
+    float *buf[NUM_OSCILLATORS]; // slice_size samples each
+    // Envelope: the running segment, then the coefficients of every stage.
+    // The segment steps its distance from `env_aim`, a point just past its
+    // goal, so the level keeps full precision however close it gets.
+    float env[NUM_OSCILLATORS];
+    float env_dist[NUM_OSCILLATORS]; // env - env_aim
+    float env_mul[NUM_OSCILLATORS];
+    float env_aim[NUM_OSCILLATORS];
+    float env_end[NUM_OSCILLATORS]; // env_dist at which the segment ends
+    float env_goal[NUM_OSCILLATORS];
+    float env_dir[NUM_OSCILLATORS]; // +1 rising, -1 falling
+    EnvStage env_stage[NUM_OSCILLATORS];
+    float attack_mul[NUM_OSCILLATORS];
+    float decay_mul[NUM_OSCILLATORS];
+    float sustain[NUM_OSCILLATORS];
+    float release_mul[NUM_OSCILLATORS];
+    // This slice's envelopes, [frame][slot] like the batch renderer's rows.
+    float env_rows[MAX_SLICE_SIZE][NUM_OSCILLATORS];
+    size_t env_off_count; // voices whose release ended, not yet retired
+    bool is_culled[NUM_OSCILLATORS]; // this slice: too quiet to render or mix
+    int mod_pair[NUM_OSCILLATORS]; // index into Synth::mod_pair_array, or -1
+    bool is_mod[NUM_OSCILLATORS];
+    size_t ui_id[NUM_OSCILLATORS];
+    int midi[NUM_OSCILLATORS];
+    size_t note_id[NUM_OSCILLATORS]; // HeldNote the voice was started for
     size_t count;
-    WaveShapeFn shape_fn;
+    WaveShape shape;
+    const struct DspKernels *dsp; // kernel build chosen for this CPU
+    bool is_fixed_phase;
 } OscillatorArray;
 
+typedef void (*VoiceRenderFn)(OscillatorArray *group, size_t slot,
+                              const float *mod_buf, float mod_ratio,
+                              size_t frames, int sample_rate);
+
+// One build of the block kernels in dsp_kernels.h, for one instruction set.
+typedef struct DspKernels
+{
+    const char *name;
+    WaveKernelFn wave[WaveCount][AliasQualityCount];
+    // [shape][alias_quality][is_fm][is_amp_ramp]
+    VoiceRenderFn voice[WaveCount][AliasQualityCount][2][2];
+    void (*render_batch)(OscillatorArray *group, size_t first, size_t count,
+                         size_t frames, int sample_rate);
+    void (*mix)(float *signal, const float *buf, size_t frames);
+    void (*envelopes)(OscillatorArray *group, size_t frames);
+} DspKernels;
+
 typedef struct ModulationPair
 {
-    Oscillator *modulator;
-    Oscillator *carrier;
+    int modulator; // voice, or -1 while unresolved
+    int carrier;
     size_t mod_id;
     float mod_ratio;
 } ModulationPair;
 
 typedef struct ModulationPairArray
 {
-    ModulationPair data[NUM_OSCILLATORS];
+    ModulationPair data[MAX_VOICES];
     size_t count;
 } ModulationPairArray;
 
+// Continuous UIOsc parameters, streamed to the renderer as events.
+typedef struct OscParams
+{
+    float freq;
+    float amp;
+    float shape_parm_0;
+    float attack;
+    float decay;
+    float sustain;
+    float release;
+} OscParams;
+
+// Structural UIOsc fields. `mod_src` is the index of the modulating patch
+// oscillator, or -1, already checked against the patch size.
+typedef struct PatchOsc
+{
+    WaveShape shape;
+    AliasQuality alias_quality;
+    bool is_kb_enabled;
+    int mod_src;
+} PatchOsc;
+
+// Oscillator and modulation layout of the patch. Built whole on the UI
+// thread and handed to the renderer through a GraphExchange.
+typedef struct PatchGraph
+{
+    PatchOsc osc[MAX_UI_OSC];
+    size_t count;
+} PatchGraph;
+
+// Triple buffer: the UI owns `back`, the renderer owns `front`, and `middle`
+// holds the most recently published graph. Publishing and picking up are one
+// atomic exchange each, so a buffer only returns to the UI for reuse after the
+// renderer has swapped it out.
+#define GRAPH_FRESH 4u
+typedef struct GraphExchange
+{
+    PatchGraph buf[3];
+    unsigned back;
+    unsigned front;
+    _Alignas(CACHE_LINE_SIZE) atomic_uint middle; // index | GRAPH_FRESH
+} GraphExchange;
+
+typedef enum SynthEventType
+{
+    EventNoteOn = 0,
+    EventNoteOff = 1,
+    EventParamSet = 2,
+} SynthEventType;
+
+typedef enum SynthParam
+{
+    ParamFreq = 0,
+    ParamAmp = 1,
+    ParamShapeParm = 2,
+    ParamAttack = 3,
+    ParamDecay = 4,
+    ParamSustain = 5,
+    ParamRelease = 6,
+} SynthParam;
+
+// `frame` is the renderer's sample clock at which the event takes effect; 0
+// means as soon as possible. Producers must push in non-decreasing frame
+// order.
+typedef struct SynthEvent
+{
+    size_t frame;
+    SynthEventType type;
+    int midi;
+    size_t ui_id;
+    SynthParam param;
+    float value;
+} SynthEvent;
+
+// Single-producer/single-consumer ring: the UI thread pushes, the renderer
+// pops. Both ends are wait-free and never allocate.
+typedef struct EventQueue
+{
+    SynthEvent data[EVENT_QUEUE_CAPACITY];
+    _Alignas(CACHE_LINE_SIZE) atomic_size_t head; // owned by the consumer
+    _Alignas(CACHE_LINE_SIZE) atomic_size_t tail; // owned by the producer
+} EventQueue;
+
+// A key that is down. Each patch oscillator gets one voice for it, and all of
+// them carry its note_id. Repeated presses of the same key are separate notes.
+typedef struct HeldNote
+{
+    int midi;
+    size_t note_id;
+} HeldNote;
+
+// Audio settings chosen at startup. Host blocks of `block_size` frames are
+// rendered as slices of at most `slice_size` frames, so per-voice buffers
+// stay small enough to live in L1.
+typedef struct EngineConfig
+{
+    int sample_rate;
+    size_t block_size;
+    size_t slice_size;
+    size_t render_threads; // threads rendering voices; 0 means one per core
+    bool is_rt_priority_requested; // ask for SCHED_FIFO on render threads
+    bool is_fixed_phase; // 32-bit integer phase accumulators instead of float
+    const char *kernels; // DspKernels build by name; NULL picks by cpuid
+    size_t polyphony;    // notes sounding at once; 0 means DEFAULT_POLYPHONY
+    StealPolicy steal_policy;
+    float cull_db; // voices quieter than this are culled; below 0, or -inf
+} EngineConfig;
+
+// A preset names a sample rate, block size and slice size; `--preset` takes
+// only those three. The first preset's config is the default for everything.
+typedef struct EnginePreset
+{
+    const char *name;
+    EngineConfig config;
+} EnginePreset;
+
+// 64 frames at 48 kHz is 1.3 ms of buffering; 1024 at 44.1 kHz is 23 ms.
+const EnginePreset ENGINE_PRESETS[] = {
+    {.name = "default",
+     .config = {.sample_rate = DEFAULT_SAMPLE_RATE,
+                .block_size = DEFAULT_BLOCK_SIZE,
+                .slice_size = DEFAULT_SLICE_SIZE,
+                .render_threads = 1,
+                .cull_db = DEFAULT_CULL_DB}},
+    {.name = "live",
+     .config = {.sample_rate = 48000,
+                .block_size = 256,
+                .slice_size = DEFAULT_SLICE_SIZE,
+                .render_threads = 1}},
+    {.name = "low",
+     .config = {.sample_rate = 48000,
+                .block_size = 128,
+                .slice_size = DEFAULT_SLICE_SIZE,
+                .render_threads = 1}},
+    {.name = "lowest",
+     .config = {.sample_rate = 48000,
+                .block_size = 64,
+                .slice_size = 16,
+                .render_threads = 1}},
+    {.name = "hires",
+     .config = {.sample_rate = 96000,
+                .block_size = 256,
+                .slice_size = MAX_SLICE_SIZE,
+                .render_threads = 1}},
+};
+#define ENGINE_PRESETS_LENGTH                                                  \
+    (sizeof(ENGINE_PRESETS) / sizeof(ENGINE_PRESETS[0]))
+
+// Chase-Lev work-stealing deque of job indices. The owning thread pushes and
+// pops at the bottom, other threads steal from the top. Indices only grow;
+// every slice drains the deque, so JOB_DEQUE_CAPACITY never wraps onto live
+// entries.
+typedef struct JobDeque
+{
+    _Alignas(CACHE_LINE_SIZE) atomic_long top;
+    _Alignas(CACHE_LINE_SIZE) atomic_long bottom;
+    atomic_int jobs[JOB_DEQUE_CAPACITY];
+} JobDeque;
+
+// Voices to render in the current slice: one voice, or a batch of `count`
+// unmodulated voices rendered in lockstep. Jobs are numbered in the serial
+// render order (group by group, slot by slot); `succ` lists the jobs that
+// must wait for this one.
+typedef struct VoiceJob
+{
+    OscillatorArray *group;
+    size_t first;
+    size_t count;
+    const float *mod_buf;
+    float mod_ratio;
+    size_t succ_start;
+    size_t succ_count;
+    int pred_count;
+} VoiceJob;
+
+struct RenderPool;
+typedef struct RenderWorker
+{
+    struct RenderPool *pool;
+    size_t index; // deque index; 0 belongs to the thread calling renderAudio
+    pthread_t thread;
+} RenderWorker;
+
+// Worker threads that render the voices of a slice in parallel. Workers
+// sleep between blocks and spin on the deques while a block is rendering.
+typedef struct RenderPool
+{
+    RenderWorker workers[MAX_RENDER_THREADS];
+    size_t worker_count; // including the render thread
+    JobDeque deques[MAX_RENDER_THREADS];
+
+    VoiceJob jobs[MAX_VOICES];
+    size_t job_count;
+    size_t succ[MAX_VOICES];
+    atomic_int pred_left[MAX_VOICES];
+    atomic_int jobs_left;
+    size_t frames;
+    int sample_rate;
+
+    atomic_bool is_block_active;
+    atomic_bool is_running;
+    bool is_rt_priority_requested;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+} RenderPool;
+
+// Render-time instrumentation. The render thread is the only writer; every
+// field is atomic so the UI can read it at any time without stalling the
+// audio path. A reader may see a window that is one block newer in places.
+typedef struct AudioStats
+{
+    _Atomic float load_window[STATS_WINDOW]; // render time / deadline
+    atomic_size_t block_count;
+    atomic_uint histogram[STATS_HISTOGRAM_BINS];
+    atomic_uint xrun_count;
+    atomic_uint culled_voices;        // in the last slice of the last block
+    atomic_size_t culled_retire_count; // released voices retired by culling
+    double last_refill_time; // push mode only, UI thread
+} AudioStats;
+
+// Point-in-time copy of AudioStats for display or for callers.
+typedef struct AudioStatsSnapshot
+{
+    float load;     // last block, fraction of its deadline
+    float load_min; // over the last STATS_WINDOW blocks
+    float load_avg;
+    float load_p99;
+    float load_max;
+    unsigned histogram[STATS_HISTOGRAM_BINS];
+    unsigned xrun_count;
+    unsigned culled_voices;
+    size_t culled_retire_count;
+    size_t block_count;
+} AudioStatsSnapshot;
+
+// One rendered block in the scope ring. `seq` is odd while the render thread
+// is writing the slot, and 2 * (times written) otherwise, which tells a
+// reader whether the slot still holds the block it expects.
+typedef struct ScopeSlot
+{
+    atomic_uint seq;
+    atomic_size_t length;
+    _Atomic float *data;
+} ScopeSlot;
+
+// The last few rendered blocks, copied out of the render buffer for the
+// scope. The render thread writes without ever waiting; a reader that races
+// with a write sees the sequence change and retries.
+typedef struct ScopeRing
+{
+    ScopeSlot *slots;
+    size_t slot_count;
+    _Atomic float *samples; // slot_count * block size
+    atomic_size_t write_count;
+} ScopeRing;
+
+// What the real-time setup steps were actually granted.
+typedef struct RtStatus
+{
+    bool is_denormal_flush_on;
+    bool is_memory_locked;
+    int mlock_error;
+    size_t prefaulted_bytes;
+    int fifo_priority; // 0 when not requested or refused
+    int fifo_error;
+} RtStatus;
+
+// Where rendering happens: polled from the UI loop (push) or requested by
+// raylib's audio thread (pull).
+typedef enum EngineMode
+{
+    EnginePush = 0,
+    EnginePull = 1,
+} EngineMode;
+
 typedef struct Synth
 {
     OscillatorArray osc_groups[WaveCount];
     size_t osc_groups_count;
+    const DspKernels *dsp;
     float *signal;
-    size_t signal_length;
-    float audio_frame_duration;
+    size_t signal_length; // block size
+    size_t slice_size;
+    int sample_rate;
+    float *osc_buf_pool;
+    ScopeRing scope_ring;
+    float *scope_snapshot; // UI thread: last consistent read of the ring
+    size_t scope_length;
+    Vector2 *scope_points;
+    AudioStats stats;
+    EngineMode engine_mode;
 
     UIOsc ui_osc[MAX_UI_OSC];
     size_t ui_osc_count;
 
     ModulationPairArray mod_pair_array;
+
+    // UI thread: what has been published to the renderer so far.
+    OscParams ui_params_sent[MAX_UI_OSC];
+    PatchGraph ui_graph_sent;
+    int ui_key_midi[KEYS_LENGTH];
+
+    // Shared between the UI thread and the renderer.
+    EventQueue event_queue;
+    GraphExchange graph_exchange;
+
+    // Renderer: state rebuilt from the current graph and drained events.
+    OscParams osc_params[MAX_UI_OSC];
+    HeldNote held_notes[MAX_HELD_NOTES]; // oldest first
+    size_t held_count;
+    size_t next_note_id;
+    size_t polyphony;
+    StealPolicy steal_policy;
+    float steal_fade_mul; // release coefficient of a stolen voice
+    float cull_level; // linear amplitude below which voices are culled
+    bool is_graph_dirty;
+    size_t render_frame; // frames rendered so far
+    RenderPool *pool;      // NULL when rendering on one thread
+    bool is_job_graph_dirty;
+
+    // Render-thread setup. In pull mode it runs on the first callback and the
+    // UI reports it once `is_rt_status_ready` flips.
+    bool is_rt_priority_requested;
+    bool is_render_thread_prepared;
+    RtStatus rt_status;
+    atomic_bool is_rt_status_ready;
+    bool is_rt_status_reported;
 } Synth;
 
 ////////////////////////////////////////////////////////////////
@@ -107,262 +572,2712 @@ float midi2freq(float midi)
 
 float freq2midi(float freq) { return 12.0f * log2f(freq / BASE_NOTE_FREQ); }
 
-Oscillator *makeOscillator(OscillatorArray *osc_arr)
+// Monotonic wall clock. Unlike GetTime it needs no window and is safe to call
+// from any thread.
+double nowSeconds(void)
 {
-    return osc_arr->osc + (osc_arr->count++);
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
 }
 
-void updatePhase(float *phase, float *phase_dt, float freq, float freq_mod)
+// Per-slot state of a voice, moved as one when voices shift.
+void copyVoice(OscillatorArray *group, size_t to, size_t from)
 {
-    *phase_dt = (freq + freq_mod) * SAMPLE_DURATION;
-    *phase += *phase_dt;
-    if (*phase < 0.0f)
-        *phase += 1.0f;
-    if (*phase >= 1.0f)
-        *phase -= 1.0f;
+    group->phase[to] = group->phase[from];
+    group->phase_acc[to] = group->phase_acc[from];
+    group->phase_dt[to] = group->phase_dt[from];
+    group->freq[to] = group->freq[from];
+    group->amp[to] = group->amp[from];
+    group->amp_target[to] = group->amp_target[from];
+    group->shape_parm_0[to] = group->shape_parm_0[from];
+    group->alias_quality[to] = group->alias_quality[from];
+    memcpy(group->min_blep_pending[to], group->min_blep_pending[from],
+           sizeof(group->min_blep_pending[to]));
+    group->min_blep_pos[to] = group->min_blep_pos[from];
+    group->buf[to] = group->buf[from];
+    group->env[to] = group->env[from];
+    group->env_dist[to] = group->env_dist[from];
+    group->env_mul[to] = group->env_mul[from];
+    group->env_aim[to] = group->env_aim[from];
+    group->env_end[to] = group->env_end[from];
+    group->env_goal[to] = group->env_goal[from];
+    group->env_dir[to] = group->env_dir[from];
+    group->env_stage[to] = group->env_stage[from];
+    group->attack_mul[to] = group->attack_mul[from];
+    group->decay_mul[to] = group->decay_mul[from];
+    group->sustain[to] = group->sustain[from];
+    group->release_mul[to] = group->release_mul[from];
+    group->mod_pair[to] = group->mod_pair[from];
+    group->is_mod[to] = group->is_mod[from];
+    group->ui_id[to] = group->ui_id[from];
+    group->midi[to] = group->midi[from];
+    group->note_id[to] = group->note_id[from];
+}
+
+// Open a slot after the group's other voices of `ui_id`, so that voices of
+// one UIOsc stay contiguous for batching. Returns -1 when the group is full.
+int insertVoice(OscillatorArray *group, size_t ui_id)
+{
+    if (group->count >= NUM_OSCILLATORS)
+        return -1;
+    size_t slot = group->count;
+    while (slot > 0 && group->ui_id[slot - 1] > ui_id)
+        slot--;
+    float *buf = group->buf[group->count];
+    for (size_t i = group->count; i > slot; i--)
+        copyVoice(group, i, i - 1);
+    group->buf[slot] = buf;
+    group->count++;
+    return (int)slot;
+}
+
+void removeVoice(OscillatorArray *group, size_t slot)
+{
+    float *buf = group->buf[slot];
+    for (size_t i = slot + 1; i < group->count; i++)
+        copyVoice(group, i - 1, i);
+    group->count--;
+    group->buf[group->count] = buf;
+}
+
+// Per-sample coefficient of a segment that shrinks its distance to its aim by
+// (1 + overshoot) / overshoot in `seconds`. Zero makes the segment instant.
+float envCoef(float seconds, float overshoot, int sample_rate)
+{
+    const float samples = seconds * sample_rate;
+    if (samples < 1.0f)
+        return 0.0f;
+    return expf(-logf((1.0f + overshoot) / overshoot) / samples);
+}
+
+// Segment coefficients of a voice for its oscillator's ADSR settings. Only
+// runs when a voice starts or the settings change, never per sample.
+void setVoiceEnvelope(OscillatorArray *group, size_t slot,
+                      const OscParams *params, int sample_rate)
+{
+    const float attack = envCoef(params->attack, ENV_ATTACK_OVERSHOOT,
+                                 sample_rate);
+    const float decay = envCoef(params->decay, ENV_DECAY_UNDERSHOOT,
+                                sample_rate);
+    const float release = envCoef(params->release, ENV_DECAY_UNDERSHOOT,
+                                  sample_rate);
+    group->attack_mul[slot] = attack;
+    group->decay_mul[slot] = decay;
+    group->sustain[slot] = params->sustain;
+    group->release_mul[slot] = release;
 }
 
-void updatePhaseOsc(Oscillator *osc)
+// Run a segment from the current level to `goal`. It aims past the goal by
+// `overshoot` times its own span, so it ends on time from any level.
+static void setEnvSegment(OscillatorArray *group, size_t slot, float mul,
+                          float goal, float overshoot)
 {
-    osc->phase_dt = osc->freq * SAMPLE_DURATION;
-    osc->phase += osc->phase_dt;
-    if (osc->phase < 0.0f)
-        osc->phase += 1.0f;
-    if (osc->phase >= 1.0f)
-        osc->phase -= 1.0f;
+    const float span = goal - group->env[slot];
+    group->env_mul[slot] = mul;
+    group->env_aim[slot] = goal + overshoot * span;
+    group->env_dist[slot] = -(1.0f + overshoot) * span;
+    group->env_end[slot] = -overshoot * span;
+    group->env_goal[slot] = goal;
+    group->env_dir[slot] = (span >= 0.0f) ? 1.0f : -1.0f;
 }
 
-void zeroSignal(float *signal)
+// Load the running segment for `stage` from the current level. Sustain and
+// off hold the level and never finish.
+void enterEnvStage(OscillatorArray *group, size_t slot, EnvStage stage)
 {
-    for (size_t i = 0; i < STREAM_BUFFER_SIZE; i++)
+    group->env_stage[slot] = stage;
+    switch (stage)
     {
-        signal[i] = 0.0f;
+    case EnvAttack:
+        setEnvSegment(group, slot, group->attack_mul[slot], 1.0f,
+                      ENV_ATTACK_OVERSHOOT);
+        break;
+    case EnvDecay:
+        setEnvSegment(group, slot, group->decay_mul[slot],
+                      group->sustain[slot], ENV_DECAY_UNDERSHOOT);
+        break;
+    case EnvRelease:
+    case EnvFade:
+        setEnvSegment(group, slot, group->release_mul[slot], 0.0f,
+                      ENV_DECAY_UNDERSHOOT);
+        break;
+    case EnvSustain:
+    case EnvOff:
+        group->env_mul[slot] = 1.0f;
+        group->env_aim[slot] = group->env[slot];
+        group->env_dist[slot] = 0.0f;
+        group->env_end[slot] = INFINITY;
+        group->env_goal[slot] = group->env[slot];
+        group->env_dir[slot] = 1.0f;
+        break;
     }
 }
 
-float bandLimitedRippleFx(float phase, float phase_dt)
+// The running segment reached its goal: land on it and go on.
+void finishEnvStage(OscillatorArray *group, size_t slot)
 {
-    if (phase < phase_dt)
+    group->env[slot] = group->env_goal[slot];
+    switch (group->env_stage[slot])
     {
-        phase /= phase_dt;
-        return phase + phase - phase * phase - 1.0f;
+    case EnvAttack:
+        enterEnvStage(group, slot, EnvDecay);
+        break;
+    case EnvDecay:
+        enterEnvStage(group, slot, EnvSustain);
+        break;
+    default:
+        enterEnvStage(group, slot, EnvOff);
+        group->env_off_count++;
+        break;
     }
-    else if (phase > 1.0f - phase_dt)
+}
+
+// Sustain and off hold the level: true when all of `count` voices from
+// `first` do, so their envelopes are flat for the whole slice.
+static inline bool isEnvelopeHeld(const OscillatorArray *group, size_t first,
+                                  size_t count)
+{
+    bool is_held = true;
+    for (size_t slot = first; slot < first + count; slot++)
+        is_held &= group->env_mul[slot] == 1.0f && group->env_dist[slot] == 0.0f;
+    return is_held;
+}
+
+// Step one voice's envelope through `frames` samples, as the SIMD lanes do.
+static inline void stepEnvelope(OscillatorArray *group, size_t slot,
+                                size_t frames)
+{
+    float env = group->env[slot];
+    if (isEnvelopeHeld(group, slot, 1))
     {
-        phase = (phase - 1.0f) / phase_dt;
-        return phase * phase + phase + phase + 1.0f;
+        for (size_t t = 0; t < frames; t++)
+            group->env_rows[t][slot] = env;
+        return;
     }
-    else
-        return 0.0f;
+    float dist = group->env_dist[slot];
+    float mul = group->env_mul[slot];
+    float aim = group->env_aim[slot];
+    float end = group->env_end[slot];
+    float dir = group->env_dir[slot];
+    for (size_t t = 0; t < frames; t++)
+    {
+        dist = dist * mul;
+        if ((dist - end) * dir >= 0.0f)
+        {
+            finishEnvStage(group, slot);
+            dist = group->env_dist[slot];
+            mul = group->env_mul[slot];
+            aim = group->env_aim[slot];
+            end = group->env_end[slot];
+            dir = group->env_dir[slot];
+        }
+        env = dist + aim;
+        group->env_rows[t][slot] = env;
+    }
+    group->env_dist[slot] = dist;
+    group->env[slot] = env;
 }
 
-// float sinWaveOsc(const Oscillator osc) { return sinf(2.0f * PI * osc.phase);
-// }
-float sinShape(float phase, float phase_dt, float shape_parm)
+void initEventQueue(EventQueue *queue)
 {
-    return sinf(2.0f * PI * phase);
+    atomic_init(&queue->head, 0);
+    atomic_init(&queue->tail, 0);
 }
 
-// float sawWaveOsc(const Oscillator osc)
-// {
-//     float sample = ((osc.phase * 2.0f) - 1.0f);
-//     sample -= bandLimitedRippleFx(osc.phase, osc.phase_dt);
-//     return sample;
-// }
-float sawShape(float phase, float phase_dt, float shape_parm)
+bool pushEvent(EventQueue *queue, SynthEvent ev)
 {
-    float sample = ((phase * 2.0f) - 1.0f);
-    sample -= bandLimitedRippleFx(phase, phase_dt);
-    return sample;
+    size_t tail = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+    size_t head = atomic_load_explicit(&queue->head, memory_order_acquire);
+    if (tail - head == EVENT_QUEUE_CAPACITY)
+        return false;
+    queue->data[tail & (EVENT_QUEUE_CAPACITY - 1)] = ev;
+    atomic_store_explicit(&queue->tail, tail + 1, memory_order_release);
+    return true;
 }
 
-// float triWaveOsc(const Oscillator osc)
-// {
-//     if (osc.phase < 0.5f)
-//         return ((osc.phase * 4.0f) - 1.0f);
-//     else
-//         return ((osc.phase * -4.0f) + 3.0f);
-// }
-float triShape(float phase, float phase_dt, float shape_parm)
+bool peekEvent(EventQueue *queue, SynthEvent *ev)
 {
-    if (phase < 0.5f)
-        return (phase * 4.0f) - 1.0f;
-    else
-        return (phase * -4.0f) + 3.0f;
+    size_t head = atomic_load_explicit(&queue->head, memory_order_relaxed);
+    size_t tail = atomic_load_explicit(&queue->tail, memory_order_acquire);
+    if (head == tail)
+        return false;
+    *ev = queue->data[head & (EVENT_QUEUE_CAPACITY - 1)];
+    return true;
 }
 
-// float sqrWaveOsc(const Oscillator osc)
-// {
-//     float duty_cycle = osc.shape_parm_0;
-//     float sample = (osc.phase < duty_cycle) ? 1.0f : -1.0f;
-//     sample += bandLimitedRippleFx(osc.phase, osc.phase_dt);
-//     sample -= bandLimitedRippleFx(fmodf(osc.phase + (1.0f -
-//     duty_cycle), 1.0f),
-//                                   osc.phase_dt);
-//     return sample;
-// }
-float sqrShape(float phase, float phase_dt, float shape_parm)
+bool popEvent(EventQueue *queue, SynthEvent *ev)
 {
-    float duty_cycle = shape_parm;
-    float sample = (phase < duty_cycle) ? 1.0f : -1.0f;
-    sample += bandLimitedRippleFx(phase, phase_dt);
-    sample -=
-        bandLimitedRippleFx(fmodf(phase + (1.0f - duty_cycle), 1.0f), phase_dt);
-    return sample;
+    size_t head = atomic_load_explicit(&queue->head, memory_order_relaxed);
+    size_t tail = atomic_load_explicit(&queue->tail, memory_order_acquire);
+    if (head == tail)
+        return false;
+    *ev = queue->data[head & (EVENT_QUEUE_CAPACITY - 1)];
+    atomic_store_explicit(&queue->head, head + 1, memory_order_release);
+    return true;
 }
 
-// float rsqWaveOsc(const Oscillator osc)
-// {
-//     float s = (osc.shape_parm_0 * 8.0f) + 2.0f;
-//     float base = (float)fabs(s);
-//     float pow = s * sinf(osc.phase * PI * 2);
-//     float denominator = powf(base, pow) + 1.0f;
-//     float sample = (2.0f / denominator) - 1.0f;
-//     return sample;
-// }
-float rsqShape(float phase, float phase_dt, float shape_parm)
+void initGraphExchange(GraphExchange *exchange)
 {
-    float s = (shape_parm * 8.0f) + 2.0f;
-    float base = (float)fabs(s);
-    float pow = s * sinf(phase * PI * 2);
-    float denominator = powf(base, pow) + 1.0f;
-    float sample = (2.0f / denominator) - 1.0f;
-    return sample;
+    exchange->front = 0;
+    exchange->back = 1;
+    atomic_init(&exchange->middle, 2);
 }
 
-// void updateOsc(Oscillator *osc, float freq_mod)
-// {
-//     osc->phase_dt = (osc->freq + freq_mod) * SAMPLE_DURATION;
-//     osc->phase += osc->phase_dt;
-//     if (osc->phase < 0.0f)
-//         osc->phase += 1.0f;
-//     if (osc->phase >= 1.0f)
-//         osc->phase -= 1.0f;
-// }
+// UI side: the graph to fill in before publishGraph.
+PatchGraph *beginGraph(GraphExchange *exchange)
+{
+    return &exchange->buf[exchange->back];
+}
 
-// void updateOscArray(WaveShapeFn base_osc_shape_fn, Synth *synth,
-//                     OscillatorArray osc_array)
-// {
-//     for (size_t i = 0; i < osc_array.count; i++)
-//     {
-//         // prevent aliasing (Nyquist )
-//         if (osc_array.osc[i].freq > (SAMPLE_RATE / 2.0f) ||
-//             osc_array.osc[i].freq < -(SAMPLE_RATE / 2.0f))
-//             continue;
-//         for (size_t t = 0; t < STREAM_BUFFER_SIZE; t++)
-//         {
-//             updateOsc(&osc_array.osc[i], 0.0f);
-//             osc_array.osc[i].buf[t] +=
-//                 base_osc_shape_fn(osc_array.osc[i]) * osc_array.osc[i].amp;
-//         }
-//     }
-// }
-void updateOscArray(OscillatorArray *osc_array, ModulationPairArray *mod_array)
+void publishGraph(GraphExchange *exchange)
 {
-    for (size_t i = 0; i < osc_array->count; i++)
-    {
-        Oscillator *osc = &(osc_array->osc[i]);
-        if (osc->freq > (SAMPLE_RATE / 2.0f) ||
-            osc->freq < -(SAMPLE_RATE / 2.0f))
-            continue;
-        ModulationPair *mod = 0;
-        for (size_t mod_i = 0; mod_i < mod_array->count; mod_i++)
-        {
-            if (mod_array->data[mod_i].carrier == osc)
-            {
-                mod = &mod_array->data[mod_i];
-                break;
-            }
-        }
-        for (size_t t = 0; t < STREAM_BUFFER_SIZE; t++)
-        {
-            float freq_mod = 0.0f;
-            if (mod)
-            {
-                freq_mod = mod->modulator->buf[t] * mod->mod_ratio;
-            }
+    unsigned prev = atomic_exchange_explicit(
+        &exchange->middle, exchange->back | GRAPH_FRESH, memory_order_acq_rel);
+    exchange->back = prev & ~GRAPH_FRESH;
+}
 
-            updatePhase(&osc->phase, &osc->phase_dt, osc->freq, freq_mod);
-            float sample = osc_array->shape_fn(osc->phase, osc->phase_dt,
-                                               osc->shape_parm_0);
-            sample *= osc->amp;
-            osc->buf[t] = sample;
-        }
-    }
+// Renderer side: swap in the newest graph if one was published. Returns true
+// when `front` changed.
+bool acquireGraph(GraphExchange *exchange)
+{
+    if (!(atomic_load_explicit(&exchange->middle, memory_order_relaxed) &
+          GRAPH_FRESH))
+        return false;
+    unsigned prev = atomic_exchange_explicit(
+        &exchange->middle, exchange->front, memory_order_acq_rel);
+    exchange->front = prev & ~GRAPH_FRESH;
+    return true;
 }
 
-void accumOscToSignal(Synth *synth)
+////////////////////////////////////////////////////////////////
+
+// Flush denormals to zero on the calling thread (FTZ and DAZ on x86, FZ on
+// AArch64). Decaying signals otherwise fall into denormals, which are up to
+// 100x slower on most cores.
+bool enableDenormalFlush(void)
 {
-    for (size_t i = 0; i < synth->osc_groups_count; i++)
-    {
-        OscillatorArray *osc_array = &synth->osc_groups[i];
-        for (size_t osc_i = 0; osc_i < osc_array->count; osc_i++)
-        {
-            Oscillator *osc = &(osc_array->osc[osc_i]);
-            if (osc->is_mod)
-                continue;
+#if defined(__SSE__)
+    _mm_setcsr(_mm_getcsr() | 0x8040);
+    return true;
+#elif defined(__aarch64__)
+    unsigned long fpcr;
+    __asm__ __volatile__("mrs %0, fpcr" : "=r"(fpcr));
+    __asm__ __volatile__("msr fpcr, %0" ::"r"(fpcr | (1ul << 24)));
+    return true;
+#else
+    return false;
+#endif
+}
 
-            for (size_t t = 0; t < STREAM_BUFFER_SIZE; t++)
-            {
-                synth->signal[t] += osc->buf[t];
-            }
-        }
-    }
+// Write to every page of [ptr, ptr + size) so the first real access on the
+// audio path cannot page-fault. Contents are left unchanged.
+size_t prefaultPages(void *ptr, size_t size)
+{
+    const size_t page_size = (size_t)sysconf(_SC_PAGESIZE);
+    volatile char *bytes = (volatile char *)ptr;
+    for (size_t i = 0; i < size; i += page_size)
+        bytes[i] = bytes[i];
+    if (size > 0)
+        bytes[size - 1] = bytes[size - 1];
+    return size;
 }
 
-void handleAudioStream(AudioStream stream, Synth *synth)
+// Pin what is mapped now and touch all engine memory. Called once from the
+// main thread after every engine buffer exists. MCL_FUTURE is left out on
+// purpose: it makes later graphics allocations fail once RLIMIT_MEMLOCK is
+// reached.
+void lockEngineMemory(Synth *synth)
 {
-    float audio_frame_duration = 0.0f;
+    RtStatus *status = &synth->rt_status;
+    status->is_memory_locked = mlockall(MCL_CURRENT) == 0;
+    status->mlock_error = status->is_memory_locked ? 0 : errno;
 
-    if (IsAudioStreamProcessed(stream))
-    {
-        const float audio_frame_start_time = GetTime();
-        zeroSignal(synth->signal);
+    status->prefaulted_bytes = prefaultPages(synth, sizeof(Synth));
+    status->prefaulted_bytes += prefaultPages(
+        synth->osc_buf_pool,
+        WaveCount * NUM_OSCILLATORS * synth->slice_size * sizeof(float));
+    status->prefaulted_bytes +=
+        prefaultPages(synth->signal, synth->signal_length * sizeof(float));
+    status->prefaulted_bytes += prefaultPages(
+        synth->scope_ring.samples,
+        synth->scope_ring.slot_count * synth->signal_length * sizeof(float));
+    if (synth->pool != NULL)
+        status->prefaulted_bytes +=
+            prefaultPages(synth->pool, sizeof(RenderPool));
+}
 
-        for (size_t i = 0; i < synth->osc_groups_count; i++)
-        {
-            OscillatorArray *osc_array = &synth->osc_groups[i];
-            updateOscArray(osc_array, &synth->mod_pair_array);
-        }
+// Per-thread setup for whichever thread renders: denormal flushing, a touched
+// stack, and SCHED_FIFO when requested.
+void prepareRenderThread(Synth *synth)
+{
+    RtStatus *status = &synth->rt_status;
+    status->is_denormal_flush_on = enableDenormalFlush();
 
-        accumOscToSignal(synth);
+    volatile char stack[RT_STACK_PREFAULT_SIZE];
+    for (size_t i = 0; i < sizeof(stack); i += 256)
+        stack[i] = 0;
+    status->prefaulted_bytes += sizeof(stack);
 
-        UpdateAudioStream(stream, synth->signal, synth->signal_length);
-        synth->audio_frame_duration = GetTime() - audio_frame_start_time;
+    if (synth->is_rt_priority_requested)
+    {
+        int priority = sched_get_priority_max(SCHED_FIFO) - 1;
+        if (priority > RT_FIFO_PRIORITY)
+            priority = RT_FIFO_PRIORITY;
+        struct sched_param param = {.sched_priority = priority};
+        status->fifo_error =
+            pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+        status->fifo_priority = (status->fifo_error == 0) ? priority : 0;
     }
+
+    synth->is_render_thread_prepared = true;
+    atomic_store_explicit(&synth->is_rt_status_ready, true,
+                          memory_order_release);
 }
 
-void drawSignal(Synth *synth)
+void printRtStatus(const Synth *synth)
 {
-    // Draw signal
-    size_t zero_crossing_idx = 0;
-    for (size_t i = 1; i < synth->signal_length; i++)
+    const RtStatus *status = &synth->rt_status;
+    printf("Render thread: %s kernels, denormal flush %s, ", synth->dsp->name,
+           status->is_denormal_flush_on ? "on" : "unavailable");
+    if (status->is_memory_locked)
+        printf("memory locked, ");
+    else
+        printf("memory not locked (%s), ", strerror(status->mlock_error));
+    printf("%zu KiB prefaulted", status->prefaulted_bytes / 1024);
+    if (status->fifo_priority > 0)
+        printf(", SCHED_FIFO priority %d\n", status->fifo_priority);
+    else if (synth->is_rt_priority_requested)
+        printf(", SCHED_FIFO refused (%s)\n", strerror(status->fifo_error));
+    else
+        printf("\n");
+}
+
+////////////////////////////////////////////////////////////////
+
+// Called by the render thread once per renderAudio. A block whose render
+// took longer than the audio it produced was delivered late.
+void recordBlockStats(AudioStats *stats, double render_seconds,
+                      double deadline_seconds)
+{
+    const float load = (float)(render_seconds / deadline_seconds);
+    size_t block =
+        atomic_load_explicit(&stats->block_count, memory_order_relaxed);
+    atomic_store_explicit(&stats->load_window[block % STATS_WINDOW], load,
+                          memory_order_relaxed);
+
+    size_t bin = (size_t)(load * (STATS_HISTOGRAM_BINS - 1));
+    if (bin >= STATS_HISTOGRAM_BINS)
+        bin = STATS_HISTOGRAM_BINS - 1;
+    atomic_fetch_add_explicit(&stats->histogram[bin], 1,
+                              memory_order_relaxed);
+    if (load > 1.0f)
+        atomic_fetch_add_explicit(&stats->xrun_count, 1,
+                                  memory_order_relaxed);
+
+    atomic_store_explicit(&stats->block_count, block + 1,
+                          memory_order_release);
+}
+
+int compareFloats(const void *a, const void *b)
+{
+    const float fa = *(const float *)a;
+    const float fb = *(const float *)b;
+    return (fa > fb) - (fa < fb);
+}
+
+void getAudioStats(AudioStats *stats, AudioStatsSnapshot *snapshot)
+{
+    memset(snapshot, 0, sizeof(*snapshot));
+    snapshot->block_count =
+        atomic_load_explicit(&stats->block_count, memory_order_acquire);
+    snapshot->xrun_count =
+        atomic_load_explicit(&stats->xrun_count, memory_order_relaxed);
+    snapshot->culled_voices =
+        atomic_load_explicit(&stats->culled_voices, memory_order_relaxed);
+    snapshot->culled_retire_count = atomic_load_explicit(
+        &stats->culled_retire_count, memory_order_relaxed);
+    for (size_t i = 0; i < STATS_HISTOGRAM_BINS; i++)
+        snapshot->histogram[i] =
+            atomic_load_explicit(&stats->histogram[i], memory_order_relaxed);
+    if (snapshot->block_count == 0)
+        return;
+
+    size_t count = snapshot->block_count;
+    if (count > STATS_WINDOW)
+        count = STATS_WINDOW;
+    float window[STATS_WINDOW];
+    double sum = 0.0;
+    for (size_t i = 0; i < count; i++)
     {
-        if (synth->signal[i] >= 0.0f && synth->signal[i - 1] < 0.0f)
-        {
-            zero_crossing_idx = i;
-            break;
-        }
+        size_t block = snapshot->block_count - 1 - i;
+        window[i] = atomic_load_explicit(
+            &stats->load_window[block % STATS_WINDOW], memory_order_relaxed);
+        sum += window[i];
     }
+    snapshot->load = window[0];
+    qsort(window, count, sizeof(float), compareFloats);
+    snapshot->load_min = window[0];
+    snapshot->load_max = window[count - 1];
+    snapshot->load_avg = (float)(sum / count);
+    snapshot->load_p99 = window[(count * 99) / 100];
+}
 
-    Vector2 signal_points[STREAM_BUFFER_SIZE];
-    const float screen_vert_midpoint = (float)(SCREEN_HEIGHT) / 2;
-    for (size_t p_i = 0; p_i < synth->signal_length; p_i++)
+////////////////////////////////////////////////////////////////
+
+void initScopeRing(ScopeRing *ring, size_t block_size)
+{
+    // Enough blocks for a full scope, plus the one being written and one of
+    // slack so a reader is not lapped by a single write.
+    ring->slot_count = (SCOPE_SAMPLES + block_size - 1) / block_size + 2;
+    ring->slots = (ScopeSlot *)calloc(ring->slot_count, sizeof(ScopeSlot));
+    ring->samples = (_Atomic float *)calloc(ring->slot_count * block_size,
+                                            sizeof(_Atomic float));
+    for (size_t i = 0; i < ring->slot_count; i++)
     {
-        const size_t signal_idx =
-            (p_i + zero_crossing_idx) % STREAM_BUFFER_SIZE;
-        signal_points[p_i].x = (float)p_i + LEFT_PANEL_WIDTH;
-        signal_points[p_i].y =
-            screen_vert_midpoint + (int)(synth->signal[signal_idx] * 100);
+        atomic_init(&ring->slots[i].seq, 0);
+        atomic_init(&ring->slots[i].length, 0);
+        ring->slots[i].data = ring->samples + i * block_size;
     }
+    atomic_init(&ring->write_count, 0);
+}
 
-    DrawLineStrip(signal_points, STREAM_BUFFER_SIZE - zero_crossing_idx,
-                  YELLOW);
+void freeScopeRing(ScopeRing *ring)
+{
+    free(ring->samples);
+    free(ring->slots);
 }
 
-void draw_ui(Synth *synth)
+// Render thread: publish one block.
+void writeScopeRing(ScopeRing *ring, const float *block, size_t length)
 {
-    const int panel_x_start = 0;
+    size_t count = atomic_load_explicit(&ring->write_count, memory_order_relaxed);
+    ScopeSlot *slot = &ring->slots[count % ring->slot_count];
+    unsigned seq = atomic_load_explicit(&slot->seq, memory_order_relaxed);
+
+    atomic_store_explicit(&slot->seq, seq + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    for (size_t i = 0; i < length; i++)
+        atomic_store_explicit(&slot->data[i], block[i], memory_order_relaxed);
+    atomic_store_explicit(&slot->length, length, memory_order_relaxed);
+    atomic_store_explicit(&slot->seq, seq + 2, memory_order_release);
+
+    atomic_store_explicit(&ring->write_count, count + 1, memory_order_release);
+}
+
+// Copy a consistent view of the newest samples, oldest first, up to
+// `capacity`. Returns the number of samples copied, or 0 if every attempt
+// raced with the writer.
+size_t readScopeRing(ScopeRing *ring, float *out, size_t capacity)
+{
+    for (int attempt = 0; attempt < SCOPE_READ_ATTEMPTS; attempt++)
+    {
+        const size_t count =
+            atomic_load_explicit(&ring->write_count, memory_order_acquire);
+
+        // Walk back from the newest block until the scope is full.
+        size_t blocks = 0;
+        size_t total = 0;
+        while (blocks < count && blocks < ring->slot_count - 1 &&
+               total < capacity)
+        {
+            const ScopeSlot *slot =
+                &ring->slots[(count - 1 - blocks) % ring->slot_count];
+            total += atomic_load_explicit(&slot->length, memory_order_relaxed);
+            blocks++;
+        }
+
+        size_t skip = (total > capacity) ? total - capacity : 0;
+        size_t copied = 0;
+        bool is_torn = false;
+        for (size_t b = blocks; b-- > 0 && !is_torn;)
+        {
+            const size_t block = count - 1 - b;
+            ScopeSlot *slot = &ring->slots[block % ring->slot_count];
+            const unsigned expected_seq =
+                2 * (unsigned)(block / ring->slot_count + 1);
+            unsigned seq_begin =
+                atomic_load_explicit(&slot->seq, memory_order_acquire);
+            size_t length =
+                atomic_load_explicit(&slot->length, memory_order_relaxed);
+            size_t start = (skip < length) ? skip : length;
+            skip -= start;
+            if (length - start > capacity - copied)
+                length = start + (capacity - copied);
+            for (size_t i = start; i < length; i++)
+                out[copied++] =
+                    atomic_load_explicit(&slot->data[i], memory_order_relaxed);
+            atomic_thread_fence(memory_order_acquire);
+            unsigned seq_end =
+                atomic_load_explicit(&slot->seq, memory_order_relaxed);
+            is_torn = seq_begin != expected_seq || seq_end != expected_seq;
+        }
+        if (!is_torn)
+            return copied;
+    }
+    return 0;
+}
+
+////////////////////////////////////////////////////////////////
+
+void updatePhase(float *phase, float *phase_dt, float freq, float freq_mod,
+                 float sample_duration)
+{
+    *phase_dt = (freq + freq_mod) * sample_duration;
+    *phase += *phase_dt;
+    if (*phase < 0.0f)
+        *phase += 1.0f;
+    if (*phase >= 1.0f)
+        *phase -= 1.0f;
+}
+
+void zeroSignal(float *signal, size_t frames)
+{
+    for (size_t i = 0; i < frames; i++)
+    {
+        signal[i] = 0.0f;
+    }
+}
+
+////////////////////////////////////////////////////////////////
+
+// From here to the last kernel build, a * b + c is never contracted into a
+// fused multiply-add. The avx2 and avx512 targets have FMA, so GCC would fuse
+// there and round once where scalar and sse2 round twice; envelopes and FM
+// feed those differences back and let the builds drift apart. Kept apart,
+// every build renders the same samples as the scalar reference. GCC takes
+// its own pragma; clang ignores that one and contracts by default, but honors
+// the standard one, which GCC does not implement. run.sh also passes
+// -ffp-contract=off for any other compiler.
+#pragma GCC push_options
+#pragma GCC optimize("fp-contract=off")
+#ifdef __clang__
+#pragma STDC FP_CONTRACT OFF
+#endif
+
+// Polynomial sine in turns: sinPoly(p) ~= sinf(2 * PI * p) for any |p| < 2^31.
+// The phase is reduced to x in [-0.5, 0.5], folded to |y| <= 0.25 with
+// sin(pi - a) = sin(a), then evaluated as the odd Taylor series of
+// sin(2 * PI * y) to degree 11. Truncation error is below 6e-8; with float
+// rounding the max error against the exact sine is about 1.6e-7 (-135 dB),
+// which is tighter than sinf(2 * PI * p) evaluated with a float argument.
+#define SIN_POLY_C1 6.28318530717958648f
+#define SIN_POLY_C3 -41.3417022403997332f
+#define SIN_POLY_C5 81.6052492760750496f
+#define SIN_POLY_C7 -76.7058597530612643f
+#define SIN_POLY_C9 42.0586939448085130f
+#define SIN_POLY_C11 -15.0946425768803434f
+
+static inline float floorFast(float x)
+{
+    float n = (float)(int)x;
+    return n - (n > x ? 1.0f : 0.0f);
+}
+
+static inline float sinPoly(float phase)
+{
+    float x = phase - floorFast(phase + 0.5f);
+    float a = fabsf(x);
+    float b = 0.5f - a;
+    float y = copysignf(a < b ? a : b, x);
+    float y2 = y * y;
+    float p = SIN_POLY_C11;
+    p = p * y2 + SIN_POLY_C9;
+    p = p * y2 + SIN_POLY_C7;
+    p = p * y2 + SIN_POLY_C5;
+    p = p * y2 + SIN_POLY_C3;
+    p = p * y2 + SIN_POLY_C1;
+    return p * y;
+}
+
+// SIMD helpers are built for every x86 target and tagged with the ISA they
+// need; dsp_kernels.h only calls them from kernels built for that ISA.
+#if defined(__x86_64__) || defined(__i386__)
+#define HAS_X86_KERNELS
+#define TARGET_SSE2 __attribute__((target("sse2")))
+#define TARGET_AVX2 __attribute__((target("avx2,fma")))
+#define TARGET_AVX512 __attribute__((target("avx512f,fma")))
+#endif
+
+#if defined(HAS_X86_KERNELS)
+static inline TARGET_AVX512 __m512 sinPoly16(__m512 phase)
+{
+    const __m512 sign = _mm512_set1_ps(-0.0f);
+    __m512 n = _mm512_roundscale_ps(_mm512_add_ps(phase, _mm512_set1_ps(0.5f)),
+                                    _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC);
+    __m512 x = _mm512_sub_ps(phase, n);
+    __m512 a = _mm512_abs_ps(x);
+    __m512 y = _mm512_min_ps(a, _mm512_sub_ps(_mm512_set1_ps(0.5f), a));
+    y = _mm512_castsi512_ps(
+        _mm512_or_si512(_mm512_castps_si512(y),
+                        _mm512_and_si512(_mm512_castps_si512(x),
+                                         _mm512_castps_si512(sign))));
+    __m512 y2 = _mm512_mul_ps(y, y);
+    __m512 p = _mm512_set1_ps(SIN_POLY_C11);
+    p = _mm512_add_ps(_mm512_mul_ps(p, y2), _mm512_set1_ps(SIN_POLY_C9));
+    p = _mm512_add_ps(_mm512_mul_ps(p, y2), _mm512_set1_ps(SIN_POLY_C7));
+    p = _mm512_add_ps(_mm512_mul_ps(p, y2), _mm512_set1_ps(SIN_POLY_C5));
+    p = _mm512_add_ps(_mm512_mul_ps(p, y2), _mm512_set1_ps(SIN_POLY_C3));
+    p = _mm512_add_ps(_mm512_mul_ps(p, y2), _mm512_set1_ps(SIN_POLY_C1));
+    return _mm512_mul_ps(p, y);
+}
+
+static inline TARGET_AVX2 __m256 sinPoly8(__m256 phase)
+{
+    const __m256 sign = _mm256_set1_ps(-0.0f);
+    __m256 x = _mm256_sub_ps(
+        phase, _mm256_floor_ps(_mm256_add_ps(phase, _mm256_set1_ps(0.5f))));
+    __m256 a = _mm256_andnot_ps(sign, x);
+    __m256 y = _mm256_min_ps(a, _mm256_sub_ps(_mm256_set1_ps(0.5f), a));
+    y = _mm256_or_ps(y, _mm256_and_ps(sign, x));
+    __m256 y2 = _mm256_mul_ps(y, y);
+    __m256 p = _mm256_set1_ps(SIN_POLY_C11);
+    p = _mm256_add_ps(_mm256_mul_ps(p, y2), _mm256_set1_ps(SIN_POLY_C9));
+    p = _mm256_add_ps(_mm256_mul_ps(p, y2), _mm256_set1_ps(SIN_POLY_C7));
+    p = _mm256_add_ps(_mm256_mul_ps(p, y2), _mm256_set1_ps(SIN_POLY_C5));
+    p = _mm256_add_ps(_mm256_mul_ps(p, y2), _mm256_set1_ps(SIN_POLY_C3));
+    p = _mm256_add_ps(_mm256_mul_ps(p, y2), _mm256_set1_ps(SIN_POLY_C1));
+    return _mm256_mul_ps(p, y);
+}
+
+static inline TARGET_SSE2 __m128 sinPoly4(__m128 phase)
+{
+    const __m128 sign = _mm_set1_ps(-0.0f);
+    const __m128 half = _mm_set1_ps(0.5f);
+    // SSE2 has no floor: truncate, then step down where that rounded up
+    __m128 v = _mm_add_ps(phase, half);
+    __m128 n = _mm_cvtepi32_ps(_mm_cvttps_epi32(v));
+    n = _mm_sub_ps(n, _mm_and_ps(_mm_cmpgt_ps(n, v), _mm_set1_ps(1.0f)));
+    __m128 x = _mm_sub_ps(phase, n);
+    __m128 a = _mm_andnot_ps(sign, x);
+    __m128 y = _mm_min_ps(a, _mm_sub_ps(half, a));
+    y = _mm_or_ps(y, _mm_and_ps(sign, x));
+    __m128 y2 = _mm_mul_ps(y, y);
+    __m128 p = _mm_set1_ps(SIN_POLY_C11);
+    p = _mm_add_ps(_mm_mul_ps(p, y2), _mm_set1_ps(SIN_POLY_C9));
+    p = _mm_add_ps(_mm_mul_ps(p, y2), _mm_set1_ps(SIN_POLY_C7));
+    p = _mm_add_ps(_mm_mul_ps(p, y2), _mm_set1_ps(SIN_POLY_C5));
+    p = _mm_add_ps(_mm_mul_ps(p, y2), _mm_set1_ps(SIN_POLY_C3));
+    p = _mm_add_ps(_mm_mul_ps(p, y2), _mm_set1_ps(SIN_POLY_C1));
+    return _mm_mul_ps(p, y);
+}
+#endif
+
+// 2^x for |x| <= 126 without libm: x = n + f with f in [-0.5, 0.5], 2^f from
+// its degree-6 Taylor series (relative error below 2e-7) and 2^n written
+// straight into the exponent bits.
+#define EXP2_C1 0.693147180559945309f
+#define EXP2_C2 0.240226506959100712f
+#define EXP2_C3 0.0555041086648215800f
+#define EXP2_C4 0.00961812910762847717f
+#define EXP2_C5 0.00133335581464284434f
+#define EXP2_C6 0.000154035303933816099f
+
+static inline float exp2Fast(float x)
+{
+    float n = floorFast(x + 0.5f);
+    float f = x - n;
+    float p = EXP2_C6;
+    p = p * f + EXP2_C5;
+    p = p * f + EXP2_C4;
+    p = p * f + EXP2_C3;
+    p = p * f + EXP2_C2;
+    p = p * f + EXP2_C1;
+    p = p * f + 1.0f;
+    union
+    {
+        int i;
+        float f;
+    } scale = {.i = ((int)n + 127) << 23};
+    return p * scale.f;
+}
+
+#if defined(HAS_X86_KERNELS)
+static inline TARGET_AVX512 __m512 exp2Fast16(__m512 x)
+{
+    __m512 n = _mm512_roundscale_ps(_mm512_add_ps(x, _mm512_set1_ps(0.5f)),
+                                    _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC);
+    __m512 f = _mm512_sub_ps(x, n);
+    __m512 p = _mm512_set1_ps(EXP2_C6);
+    p = _mm512_add_ps(_mm512_mul_ps(p, f), _mm512_set1_ps(EXP2_C5));
+    p = _mm512_add_ps(_mm512_mul_ps(p, f), _mm512_set1_ps(EXP2_C4));
+    p = _mm512_add_ps(_mm512_mul_ps(p, f), _mm512_set1_ps(EXP2_C3));
+    p = _mm512_add_ps(_mm512_mul_ps(p, f), _mm512_set1_ps(EXP2_C2));
+    p = _mm512_add_ps(_mm512_mul_ps(p, f), _mm512_set1_ps(EXP2_C1));
+    p = _mm512_add_ps(_mm512_mul_ps(p, f), _mm512_set1_ps(1.0f));
+    __m512i e = _mm512_add_epi32(_mm512_cvtps_epi32(n), _mm512_set1_epi32(127));
+    return _mm512_mul_ps(p, _mm512_castsi512_ps(_mm512_slli_epi32(e, 23)));
+}
+
+static inline TARGET_AVX2 __m256 exp2Fast8(__m256 x)
+{
+    __m256 n = _mm256_floor_ps(_mm256_add_ps(x, _mm256_set1_ps(0.5f)));
+    __m256 f = _mm256_sub_ps(x, n);
+    __m256 p = _mm256_set1_ps(EXP2_C6);
+    p = _mm256_add_ps(_mm256_mul_ps(p, f), _mm256_set1_ps(EXP2_C5));
+    p = _mm256_add_ps(_mm256_mul_ps(p, f), _mm256_set1_ps(EXP2_C4));
+    p = _mm256_add_ps(_mm256_mul_ps(p, f), _mm256_set1_ps(EXP2_C3));
+    p = _mm256_add_ps(_mm256_mul_ps(p, f), _mm256_set1_ps(EXP2_C2));
+    p = _mm256_add_ps(_mm256_mul_ps(p, f), _mm256_set1_ps(EXP2_C1));
+    p = _mm256_add_ps(_mm256_mul_ps(p, f), _mm256_set1_ps(1.0f));
+    __m256i e = _mm256_add_epi32(_mm256_cvtps_epi32(n), _mm256_set1_epi32(127));
+    return _mm256_mul_ps(p, _mm256_castsi256_ps(_mm256_slli_epi32(e, 23)));
+}
+
+static inline TARGET_SSE2 __m128 exp2Fast4(__m128 x)
+{
+    __m128 v = _mm_add_ps(x, _mm_set1_ps(0.5f));
+    __m128 n = _mm_cvtepi32_ps(_mm_cvttps_epi32(v));
+    n = _mm_sub_ps(n, _mm_and_ps(_mm_cmpgt_ps(n, v), _mm_set1_ps(1.0f)));
+    __m128 f = _mm_sub_ps(x, n);
+    __m128 p = _mm_set1_ps(EXP2_C6);
+    p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(EXP2_C5));
+    p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(EXP2_C4));
+    p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(EXP2_C3));
+    p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(EXP2_C2));
+    p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(EXP2_C1));
+    p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(1.0f));
+    __m128i e = _mm_add_epi32(_mm_cvttps_epi32(n), _mm_set1_epi32(127));
+    return _mm_mul_ps(p, _mm_castsi128_ps(_mm_slli_epi32(e, 23)));
+}
+#endif
+
+////////////////////////////////////////////////////////////////
+
+float bandLimitedRippleFx(float phase, float phase_dt)
+{
+    if (phase < phase_dt)
+    {
+        phase /= phase_dt;
+        return phase + phase - phase * phase - 1.0f;
+    }
+    else if (phase > 1.0f - phase_dt)
+    {
+        phase = (phase - 1.0f) / phase_dt;
+        return phase * phase + phase + phase + 1.0f;
+    }
+    else
+        return 0.0f;
+}
+
+// 4-point BLEP: the integrated cubic B-spline spreads each edge over two
+// samples either side. blep4Edge(e) is twice the distance between that step
+// and the naive one, e samples from the edge, for e in [0, 2].
+static inline float blep4Edge(float e)
+{
+    if (e < 1.0f)
+        return 1.0f + e * (e * e * ((2.0f / 3.0f) - 0.25f * e) - (4.0f / 3.0f));
+    float u = 2.0f - e;
+    u *= u;
+    return u * u * (1.0f / 12.0f);
+}
+
+float blep4RippleFx(float phase, float phase_dt)
+{
+    if (phase < 2.0f * phase_dt)
+        return -blep4Edge(phase / phase_dt);
+    else if (phase > 1.0f - 2.0f * phase_dt)
+        return blep4Edge((1.0f - phase) / phase_dt);
+    else
+        return 0.0f;
+}
+
+// MinBLEP: the step response of a minimum-phase windowed sinc, minus one,
+// oversampled. It is causal, so a voice sums the tails of every edge of the
+// last MIN_BLEP_SAMPLES samples instead of looking ahead. Built once, like
+// the wavetables.
+static float min_blep_table[MIN_BLEP_SIZE + 1];
+static float min_blep_area; // integral of the table, in samples
+static bool is_min_blep_ready = false;
+
+// In-place radix-2 FFT; `n` is a power of two. The inverse is unscaled.
+static void fftInPlace(double *re, double *im, int n, bool is_inverse)
+{
+    for (int i = 1, j = 0; i < n; i++)
+    {
+        int bit = n >> 1;
+        for (; j & bit; bit >>= 1)
+            j ^= bit;
+        j ^= bit;
+        if (i < j)
+        {
+            double t = re[i];
+            re[i] = re[j];
+            re[j] = t;
+            t = im[i];
+            im[i] = im[j];
+            im[j] = t;
+        }
+    }
+    for (int len = 2; len <= n; len <<= 1)
+    {
+        const double angle = (is_inverse ? 2.0 : -2.0) * PI / len;
+        for (int i = 0; i < n; i += len)
+        {
+            for (int k = 0; k < len / 2; k++)
+            {
+                const double wr = cos(angle * k);
+                const double wi = sin(angle * k);
+                double *ar = &re[i + k], *ai = &im[i + k];
+                double *br = &re[i + k + len / 2], *bi = &im[i + k + len / 2];
+                const double tr = *br * wr - *bi * wi;
+                const double ti = *br * wi + *bi * wr;
+                *br = *ar - tr;
+                *bi = *ai - ti;
+                *ar += tr;
+                *ai += ti;
+            }
+        }
+    }
+}
+
+// Blackman-windowed sinc, made minimum-phase through the real cepstrum
+// (fold the anticausal half onto the causal one), then integrated.
+void initMinBlepTable(void)
+{
+    if (is_min_blep_ready)
+        return;
+
+    const int n = MIN_BLEP_FFT_SIZE;
+    static double re[MIN_BLEP_FFT_SIZE], im[MIN_BLEP_FFT_SIZE];
+    for (int i = 0; i < n; i++)
+    {
+        re[i] = 0.0;
+        im[i] = 0.0;
+    }
+    for (int i = 0; i <= MIN_BLEP_SIZE; i++)
+    {
+        const double x = MIN_BLEP_CUTOFF * (i - MIN_BLEP_SIZE / 2) /
+                         MIN_BLEP_OVERSAMPLING;
+        const double sinc = (x == 0.0) ? 1.0 : sin(PI * x) / (PI * x);
+        const double w = 2.0 * PI * i / MIN_BLEP_SIZE;
+        re[i] = sinc * (0.42 - 0.5 * cos(w) + 0.08 * cos(2.0 * w));
+    }
+
+    // Real cepstrum of the magnitude response.
+    fftInPlace(re, im, n, false);
+    for (int i = 0; i < n; i++)
+    {
+        const double mag = sqrt(re[i] * re[i] + im[i] * im[i]);
+        re[i] = log(mag > 1e-12 ? mag : 1e-12);
+        im[i] = 0.0;
+    }
+    fftInPlace(re, im, n, true);
+    for (int i = 0; i < n; i++)
+    {
+        const double fold = (i == 0 || i == n / 2) ? 1.0 : (i < n / 2) ? 2.0
+                                                                       : 0.0;
+        re[i] *= fold / n;
+        im[i] = 0.0;
+    }
+
+    // Back through exp to the minimum-phase impulse response.
+    fftInPlace(re, im, n, false);
+    for (int i = 0; i < n; i++)
+    {
+        const double mag = exp(re[i]);
+        re[i] = mag * cos(im[i]);
+        im[i] = mag * sin(im[i]);
+    }
+    fftInPlace(re, im, n, true);
+
+    double total = 0.0;
+    for (int i = 0; i < n; i++)
+        total += re[i];
+    double step = 0.0;
+    for (int i = 0; i < MIN_BLEP_SIZE; i++)
+    {
+        step += re[i];
+        min_blep_table[i] = (float)(step / total - 1.0);
+    }
+    min_blep_table[MIN_BLEP_SIZE] = 0.0f;
+
+    // Trapezoids, to match the linear interpolation between entries.
+    double area = -0.5 * min_blep_table[0];
+    for (int i = 0; i < MIN_BLEP_SIZE; i++)
+        area += min_blep_table[i];
+    min_blep_area = (float)(area / MIN_BLEP_OVERSAMPLING);
+    is_min_blep_ready = true;
+}
+
+// Add the tail of an edge `d` samples ago (0 <= d < 1), scaled by `height`,
+// to the corrections pending for this sample and the next ones. Every tap
+// shares the fraction of `d`, so tap k reads entries i and i + 1 at
+// i = i0 + k * MIN_BLEP_OVERSAMPLING.
+static void addMinBlepEdge(float *pending, size_t pos, float d, float height)
+{
+    const float table_pos = d * MIN_BLEP_OVERSAMPLING;
+    int i0 = (int)table_pos;
+    if (i0 >= MIN_BLEP_OVERSAMPLING)
+        i0 = MIN_BLEP_OVERSAMPLING - 1;
+    const float frac = table_pos - (float)i0;
+    const float *tap = &min_blep_table[i0];
+    for (size_t k = 0; k < MIN_BLEP_SAMPLES; k++)
+    {
+        const float a = tap[k * MIN_BLEP_OVERSAMPLING];
+        const float b = tap[k * MIN_BLEP_OVERSAMPLING + 1];
+        pending[(pos + k) & (MIN_BLEP_SAMPLES - 1)] +=
+            height * (a + frac * (b - a));
+    }
+}
+
+bool isMinBlepVoice(const OscillatorArray *group, size_t slot)
+{
+    return group->alias_quality[slot] == AliasMinBlep &&
+           (group->shape == WaveSaw || group->shape == WaveSqr);
+}
+
+void clearMinBlep(OscillatorArray *group, size_t slot)
+{
+    memset(group->min_blep_pending[slot], 0,
+           sizeof(group->min_blep_pending[slot]));
+    group->min_blep_pos[slot] = 0;
+}
+
+// MinBLEP for one slice of a voice, over the naive saw or square in `buf`.
+// Each edge queues its tail in the voice's ring, at the increment it happened
+// with, so FM edges are exact and a new voice has no edges before its first.
+// The band-limited steps land about -min_blep_area samples late; the saw ramp
+// is delayed as much, which keeps it free of DC at any pitch. Square edges
+// come in opposite pairs and need nothing.
+void applyMinBlep(OscillatorArray *group, size_t slot, const float *phase,
+                  const float *phase_dt, float *buf, size_t frames)
+{
+    float *pending = group->min_blep_pending[slot];
+    size_t pos = group->min_blep_pos[slot];
+    const bool is_sqr = group->shape == WaveSqr;
+    const float duty_cycle = group->shape_parm_0[slot];
+    for (size_t t = 0; t < frames; t++)
+    {
+        const float dt = phase_dt[t];
+        if (dt > 0.0f)
+        {
+            if (phase[t] < dt)
+                addMinBlepEdge(pending, pos, phase[t] / dt,
+                               is_sqr ? 2.0f : -2.0f);
+            if (is_sqr)
+            {
+                float fall_phase = phase[t] + (1.0f - duty_cycle);
+                if (fall_phase >= 1.0f)
+                    fall_phase -= 1.0f;
+                if (fall_phase < dt)
+                    addMinBlepEdge(pending, pos, fall_phase / dt, -2.0f);
+            }
+            else
+            {
+                buf[t] += 2.0f * min_blep_area * dt;
+            }
+        }
+        buf[t] += pending[pos];
+        pending[pos] = 0.0f;
+        pos = (pos + 1) & (MIN_BLEP_SAMPLES - 1);
+    }
+    group->min_blep_pos[slot] = pos;
+}
+
+// Correction subtracted at each rising edge (added at falling ones).
+static inline __attribute__((always_inline)) float
+bandLimitedRipple(float phase, float phase_dt, AliasQuality quality)
+{
+    switch (quality)
+    {
+    case AliasNaive:
+        return 0.0f;
+    case AliasBlep4:
+        return blep4RippleFx(phase, phase_dt);
+    case AliasMinBlep: // stateful, added per voice by applyMinBlep
+        return 0.0f;
+    default:
+        return bandLimitedRippleFx(phase, phase_dt);
+    }
+}
+
+// float sinWaveOsc(const Oscillator osc) { return sinf(2.0f * PI * osc.phase);
+// }
+static inline float sinShape(float phase, float phase_dt,
+                             float shape_parm)
+{
+    return sinPoly(phase);
+}
+
+// float sawWaveOsc(const Oscillator osc)
+// {
+//     float sample = ((osc.phase * 2.0f) - 1.0f);
+//     sample -= bandLimitedRippleFx(osc.phase, osc.phase_dt);
+//     return sample;
+// }
+static inline float sawShape(float phase, float phase_dt,
+                             float shape_parm, AliasQuality quality)
+{
+    float sample = ((phase * 2.0f) - 1.0f);
+    sample -= bandLimitedRipple(phase, phase_dt, quality);
+    return sample;
+}
+
+// float triWaveOsc(const Oscillator osc)
+// {
+//     if (osc.phase < 0.5f)
+//         return ((osc.phase * 4.0f) - 1.0f);
+//     else
+//         return ((osc.phase * -4.0f) + 3.0f);
+// }
+static inline float triShape(float phase, float phase_dt,
+                             float shape_parm)
+{
+    if (phase < 0.5f)
+        return (phase * 4.0f) - 1.0f;
+    else
+        return (phase * -4.0f) + 3.0f;
+}
+
+// float sqrWaveOsc(const Oscillator osc)
+// {
+//     float duty_cycle = osc.shape_parm_0;
+//     float sample = (osc.phase < duty_cycle) ? 1.0f : -1.0f;
+//     sample += bandLimitedRippleFx(osc.phase, osc.phase_dt);
+//     sample -= bandLimitedRippleFx(fmodf(osc.phase + (1.0f -
+//     duty_cycle), 1.0f),
+//                                   osc.phase_dt);
+//     return sample;
+// }
+static inline float sqrShape(float phase, float phase_dt,
+                             float shape_parm, AliasQuality quality)
+{
+    float duty_cycle = shape_parm;
+    float sample = (phase < duty_cycle) ? 1.0f : -1.0f;
+    // fmodf(phase + (1 - duty_cycle), 1) without the libm call; exact for
+    // phase and duty in [0, 1], as in the SIMD kernels.
+    float fall_phase = phase + (1.0f - duty_cycle);
+    if (fall_phase >= 1.0f)
+        fall_phase -= 1.0f;
+    sample += bandLimitedRipple(phase, phase_dt, quality);
+    sample -= bandLimitedRipple(fall_phase, phase_dt, quality);
+    return sample;
+}
+
+// Reference formula, checked by --selftest. rsqKernel computes the same
+// curve without libm.
+static inline float rsqShape(float phase, float shape_parm)
+{
+    float s = (shape_parm * 8.0f) + 2.0f;
+    float base = (float)fabs(s);
+    float pow = s * sinf(phase * PI * 2);
+    float denominator = powf(base, pow) + 1.0f;
+    float sample = (2.0f / denominator) - 1.0f;
+    return sample;
+}
+
+// Branchless PolyBLEP for saw and square: both sides of the correction are
+// evaluated and the lane masks pick one, as in the scalar if/else chain
+// (the lower edge wins when the two overlap). The square's fmodf becomes
+// a masked subtract, which is exact for phase and duty in [0, 1].
+#if defined(HAS_X86_KERNELS)
+static inline TARGET_AVX512 __m512 bandLimitedRipple16(__m512 p, __m512 dt)
+{
+    const __m512 one = _mm512_set1_ps(1.0f);
+    __mmask16 below = _mm512_cmp_ps_mask(p, dt, _CMP_LT_OQ);
+    __mmask16 above = _mm512_cmp_ps_mask(p, _mm512_sub_ps(one, dt), _CMP_GT_OQ);
+    above &= ~below;
+    __m512 x = _mm512_div_ps(p, dt);
+    __m512 lo = _mm512_sub_ps(
+        _mm512_sub_ps(_mm512_add_ps(x, x), _mm512_mul_ps(x, x)), one);
+    x = _mm512_div_ps(_mm512_sub_ps(p, one), dt);
+    __m512 hi = _mm512_add_ps(
+        _mm512_add_ps(_mm512_add_ps(_mm512_mul_ps(x, x), x), x), one);
+    return _mm512_mask_mov_ps(_mm512_maskz_mov_ps(below, lo), above, hi);
+}
+
+static inline TARGET_AVX2 __m256 bandLimitedRipple8(__m256 p, __m256 dt)
+{
+    const __m256 one = _mm256_set1_ps(1.0f);
+    __m256 below = _mm256_cmp_ps(p, dt, _CMP_LT_OQ);
+    __m256 above = _mm256_cmp_ps(p, _mm256_sub_ps(one, dt), _CMP_GT_OQ);
+    above = _mm256_andnot_ps(below, above);
+    __m256 x = _mm256_div_ps(p, dt);
+    __m256 lo = _mm256_sub_ps(
+        _mm256_sub_ps(_mm256_add_ps(x, x), _mm256_mul_ps(x, x)), one);
+    x = _mm256_div_ps(_mm256_sub_ps(p, one), dt);
+    __m256 hi = _mm256_add_ps(
+        _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(x, x), x), x), one);
+    return _mm256_or_ps(_mm256_and_ps(below, lo), _mm256_and_ps(above, hi));
+}
+
+static inline TARGET_SSE2 __m128 bandLimitedRipple4(__m128 p, __m128 dt)
+{
+    const __m128 one = _mm_set1_ps(1.0f);
+    __m128 below = _mm_cmplt_ps(p, dt);
+    __m128 above = _mm_andnot_ps(below, _mm_cmpgt_ps(p, _mm_sub_ps(one, dt)));
+    __m128 x = _mm_div_ps(p, dt);
+    __m128 lo = _mm_sub_ps(_mm_sub_ps(_mm_add_ps(x, x), _mm_mul_ps(x, x)), one);
+    x = _mm_div_ps(_mm_sub_ps(p, one), dt);
+    __m128 hi = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), x), x), one);
+    return _mm_or_ps(_mm_and_ps(below, lo), _mm_and_ps(above, hi));
+}
+
+// blep4RippleFx with the same masks: e is the distance to the nearer edge
+// and the lanes after an edge get the negated correction.
+static inline TARGET_AVX512 __m512 blep4Ripple16(__m512 p, __m512 dt)
+{
+    const __m512 one = _mm512_set1_ps(1.0f);
+    const __m512 two_dt = _mm512_add_ps(dt, dt);
+    __mmask16 below = _mm512_cmp_ps_mask(p, two_dt, _CMP_LT_OQ);
+    __mmask16 above =
+        _mm512_cmp_ps_mask(p, _mm512_sub_ps(one, two_dt), _CMP_GT_OQ);
+    __m512 e =
+        _mm512_div_ps(_mm512_mask_mov_ps(_mm512_sub_ps(one, p), below, p), dt);
+    __m512 inner = _mm512_sub_ps(
+        _mm512_mul_ps(_mm512_mul_ps(e, e),
+                      _mm512_sub_ps(_mm512_set1_ps(2.0f / 3.0f),
+                                    _mm512_mul_ps(_mm512_set1_ps(0.25f), e))),
+        _mm512_set1_ps(4.0f / 3.0f));
+    inner = _mm512_add_ps(one, _mm512_mul_ps(e, inner));
+    __m512 u = _mm512_sub_ps(_mm512_set1_ps(2.0f), e);
+    u = _mm512_mul_ps(u, u);
+    __m512 outer = _mm512_mul_ps(_mm512_mul_ps(u, u),
+                                 _mm512_set1_ps(1.0f / 12.0f));
+    __m512 edge = _mm512_mask_mov_ps(
+        outer, _mm512_cmp_ps_mask(e, one, _CMP_LT_OQ), inner);
+    edge = _mm512_mask_sub_ps(edge, below, _mm512_setzero_ps(), edge);
+    return _mm512_maskz_mov_ps(below | above, edge);
+}
+
+static inline TARGET_AVX2 __m256 blep4Ripple8(__m256 p, __m256 dt)
+{
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const __m256 two_dt = _mm256_add_ps(dt, dt);
+    __m256 below = _mm256_cmp_ps(p, two_dt, _CMP_LT_OQ);
+    __m256 above = _mm256_cmp_ps(p, _mm256_sub_ps(one, two_dt), _CMP_GT_OQ);
+    __m256 e =
+        _mm256_div_ps(_mm256_blendv_ps(_mm256_sub_ps(one, p), p, below), dt);
+    __m256 inner = _mm256_sub_ps(
+        _mm256_mul_ps(_mm256_mul_ps(e, e),
+                      _mm256_sub_ps(_mm256_set1_ps(2.0f / 3.0f),
+                                    _mm256_mul_ps(_mm256_set1_ps(0.25f), e))),
+        _mm256_set1_ps(4.0f / 3.0f));
+    inner = _mm256_add_ps(one, _mm256_mul_ps(e, inner));
+    __m256 u = _mm256_sub_ps(_mm256_set1_ps(2.0f), e);
+    u = _mm256_mul_ps(u, u);
+    __m256 outer = _mm256_mul_ps(_mm256_mul_ps(u, u),
+                                 _mm256_set1_ps(1.0f / 12.0f));
+    __m256 edge =
+        _mm256_blendv_ps(outer, inner, _mm256_cmp_ps(e, one, _CMP_LT_OQ));
+    edge = _mm256_xor_ps(edge, _mm256_and_ps(below, _mm256_set1_ps(-0.0f)));
+    return _mm256_and_ps(_mm256_or_ps(below, above), edge);
+}
+
+static inline TARGET_SSE2 __m128 blep4Ripple4(__m128 p, __m128 dt)
+{
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 two_dt = _mm_add_ps(dt, dt);
+    __m128 below = _mm_cmplt_ps(p, two_dt);
+    __m128 above = _mm_cmpgt_ps(p, _mm_sub_ps(one, two_dt));
+    __m128 e = _mm_or_ps(_mm_and_ps(below, p),
+                         _mm_andnot_ps(below, _mm_sub_ps(one, p)));
+    e = _mm_div_ps(e, dt);
+    __m128 inner = _mm_sub_ps(
+        _mm_mul_ps(_mm_mul_ps(e, e),
+                   _mm_sub_ps(_mm_set1_ps(2.0f / 3.0f),
+                              _mm_mul_ps(_mm_set1_ps(0.25f), e))),
+        _mm_set1_ps(4.0f / 3.0f));
+    inner = _mm_add_ps(one, _mm_mul_ps(e, inner));
+    __m128 u = _mm_sub_ps(_mm_set1_ps(2.0f), e);
+    u = _mm_mul_ps(u, u);
+    __m128 outer = _mm_mul_ps(_mm_mul_ps(u, u), _mm_set1_ps(1.0f / 12.0f));
+    __m128 near = _mm_cmplt_ps(e, one);
+    __m128 edge =
+        _mm_or_ps(_mm_and_ps(near, inner), _mm_andnot_ps(near, outer));
+    edge = _mm_xor_ps(edge, _mm_and_ps(below, _mm_set1_ps(-0.0f)));
+    return _mm_and_ps(_mm_or_ps(below, above), edge);
+}
+
+// Per-width bandLimitedRipple. MinBLEP never gets here: see applyMinBlep.
+static inline TARGET_AVX512 __m512 aliasRipple16(__m512 p, __m512 dt,
+                                                 AliasQuality quality)
+{
+    switch (quality)
+    {
+    case AliasNaive:
+        return _mm512_setzero_ps();
+    case AliasBlep4:
+        return blep4Ripple16(p, dt);
+    default:
+        return bandLimitedRipple16(p, dt);
+    }
+}
+
+static inline TARGET_AVX2 __m256 aliasRipple8(__m256 p, __m256 dt,
+                                              AliasQuality quality)
+{
+    switch (quality)
+    {
+    case AliasNaive:
+        return _mm256_setzero_ps();
+    case AliasBlep4:
+        return blep4Ripple8(p, dt);
+    default:
+        return bandLimitedRipple8(p, dt);
+    }
+}
+
+static inline TARGET_SSE2 __m128 aliasRipple4(__m128 p, __m128 dt,
+                                              AliasQuality quality)
+{
+    switch (quality)
+    {
+    case AliasNaive:
+        return _mm_setzero_ps();
+    case AliasBlep4:
+        return blep4Ripple4(p, dt);
+    default:
+        return bandLimitedRipple4(p, dt);
+    }
+}
+#endif
+
+////////////////////////////////////////////////////////////////
+
+// Mipmapped wavetables. Level m holds harmonics 1..(WAVE_TABLE_HARMONICS >> m)
+// of each waveform, so a voice reads the level whose top harmonic stays
+// below Nyquist for its current phase increment. Tables are shared by all
+// synths and built once; the extra guard sample makes interpolation
+// wrap-free.
+#define WAVE_TABLE_SIZE 2048
+#define WAVE_TABLE_HARMONICS (WAVE_TABLE_SIZE / 4)
+#define WAVE_TABLE_LEVELS 10
+
+typedef enum WaveTableKind
+{
+    WaveTableSaw = 0,
+    WaveTableSqr = 1,
+    WaveTableCount
+} WaveTableKind;
+
+static float wave_tables[WaveTableCount][WAVE_TABLE_LEVELS]
+                        [WAVE_TABLE_SIZE + 1];
+static bool is_wave_tables_ready = false;
+
+// Fourier amplitude of harmonic k, matching sawShape and sqrShape at 50%
+// duty.
+float waveTableHarmonic(WaveTableKind kind, int k)
+{
+    switch (kind)
+    {
+    case WaveTableSaw:
+        return -2.0f / (PI * k);
+    case WaveTableSqr:
+        return (k % 2) ? 4.0f / (PI * k) : 0.0f;
+    default:
+        return 0.0f;
+    }
+}
+
+void initWaveTables(void)
+{
+    if (is_wave_tables_ready)
+        return;
+
+    static float sine[WAVE_TABLE_SIZE];
+    for (int i = 0; i < WAVE_TABLE_SIZE; i++)
+        sine[i] = sinf(2.0f * PI * i / WAVE_TABLE_SIZE);
+
+    for (int kind = 0; kind < WaveTableCount; kind++)
+    {
+        for (int level = 0; level < WAVE_TABLE_LEVELS; level++)
+        {
+            float *table = wave_tables[kind][level];
+            const int harmonics = WAVE_TABLE_HARMONICS >> level;
+            for (int i = 0; i < WAVE_TABLE_SIZE; i++)
+            {
+                float sample = 0.0f;
+                for (int k = 1; k <= harmonics; k++)
+                {
+                    sample += waveTableHarmonic(kind, k) *
+                              sine[(k * i) & (WAVE_TABLE_SIZE - 1)];
+                }
+                table[i] = sample;
+            }
+            table[WAVE_TABLE_SIZE] = table[0];
+        }
+    }
+    is_wave_tables_ready = true;
+}
+
+// Smallest level whose top harmonic is below Nyquist:
+// ceil(log2(2 * WAVE_TABLE_HARMONICS * |phase_dt|)), read off the float
+// exponent.
+static inline int waveTableLevel(float phase_dt)
+{
+    union
+    {
+        float f;
+        unsigned int u;
+    } x = {.f = fabsf(phase_dt) * (2.0f * WAVE_TABLE_HARMONICS)};
+    int level = (int)((x.u >> 23) & 0xff) - 127 + ((x.u & 0x7fffff) != 0);
+    if (level < 0)
+        level = 0;
+    if (level > WAVE_TABLE_LEVELS - 1)
+        level = WAVE_TABLE_LEVELS - 1;
+    return level;
+}
+
+// void updateOsc(Oscillator *osc, float freq_mod)
+// {
+//     osc->phase_dt = (osc->freq + freq_mod) * SAMPLE_DURATION;
+//     osc->phase += osc->phase_dt;
+//     if (osc->phase < 0.0f)
+//         osc->phase += 1.0f;
+//     if (osc->phase >= 1.0f)
+//         osc->phase -= 1.0f;
+// }
+
+// void updateOscArray(WaveShapeFn base_osc_shape_fn, Synth *synth,
+//                     OscillatorArray osc_array)
+// {
+//     for (size_t i = 0; i < osc_array.count; i++)
+//     {
+//         // prevent aliasing (Nyquist )
+//         if (osc_array.osc[i].freq > (SAMPLE_RATE / 2.0f) ||
+//             osc_array.osc[i].freq < -(SAMPLE_RATE / 2.0f))
+//             continue;
+//         for (size_t t = 0; t < STREAM_BUFFER_SIZE; t++)
+//         {
+//             updateOsc(&osc_array.osc[i], 0.0f);
+//             osc_array.osc[i].buf[t] +=
+//                 base_osc_shape_fn(osc_array.osc[i]) * osc_array.osc[i].amp;
+//         }
+//     }
+// }
+// Buffer of the voice modulating `voice`, or NULL when it is unmodulated.
+const float *findModulatorBuf(Synth *synth, int voice, float *mod_ratio)
+{
+    const OscillatorArray *group = &synth->osc_groups[voice / NUM_OSCILLATORS];
+    int pair_i = group->mod_pair[voice % NUM_OSCILLATORS];
+    if (pair_i < 0)
+        return NULL;
+    const ModulationPair *mod = &synth->mod_pair_array.data[pair_i];
+    if (mod->modulator < 0)
+        return NULL;
+    *mod_ratio = mod->mod_ratio;
+    return synth->osc_groups[mod->modulator / NUM_OSCILLATORS]
+        .buf[mod->modulator % NUM_OSCILLATORS];
+}
+
+// Wrap into [0, 1). x - floor(x) can round up to 1.0 for tiny negative x,
+// hence the second step.
+static inline float wrapPhase(float x)
+{
+    x -= floorFast(x);
+    return (x >= 1.0f) ? x - 1.0f : x;
+}
+
+#if defined(HAS_X86_KERNELS)
+static inline TARGET_AVX512 __m512 wrapPhase16(__m512 x)
+{
+    const __m512 one = _mm512_set1_ps(1.0f);
+    x = _mm512_sub_ps(x, _mm512_roundscale_ps(x, _MM_FROUND_TO_NEG_INF |
+                                                     _MM_FROUND_NO_EXC));
+    __mmask16 above = _mm512_cmp_ps_mask(x, one, _CMP_GE_OQ);
+    return _mm512_mask_sub_ps(x, above, x, one);
+}
+
+static inline TARGET_AVX2 __m256 wrapPhase8(__m256 x)
+{
+    const __m256 one = _mm256_set1_ps(1.0f);
+    x = _mm256_sub_ps(x, _mm256_floor_ps(x));
+    __m256 above = _mm256_cmp_ps(x, one, _CMP_GE_OQ);
+    return _mm256_sub_ps(x, _mm256_and_ps(above, one));
+}
+
+static inline TARGET_SSE2 __m128 wrapPhase4(__m128 x)
+{
+    const __m128 one = _mm_set1_ps(1.0f);
+    __m128 n = _mm_cvtepi32_ps(_mm_cvttps_epi32(x));
+    n = _mm_sub_ps(n, _mm_and_ps(_mm_cmpgt_ps(n, x), one));
+    x = _mm_sub_ps(x, n);
+    return _mm_sub_ps(x, _mm_and_ps(_mm_cmpge_ps(x, one), one));
+}
+#endif
+
+// Fixed-point phase: one cycle is 2^32, so the wrap is unsigned overflow and
+// no rounding accumulates however long a note is held. Kernels see the top
+// 24 bits, which convert to a float in [0, 1) exactly.
+static inline uint32_t phaseIncrement(float phase_dt)
+{
+    return (uint32_t)(int64_t)(phase_dt * 4294967296.0f);
+}
+
+static inline float fixedPhaseToFloat(uint32_t phase)
+{
+    return (float)(phase >> 8) * 0x1p-24f;
+}
+
+#if defined(HAS_X86_KERNELS)
+static inline TARGET_AVX512 __m512 fixedPhaseToFloat16(__m512i phase)
+{
+    __m512 top = _mm512_cvtepi32_ps(_mm512_srli_epi32(phase, 8));
+    return _mm512_mul_ps(top, _mm512_set1_ps(0x1p-24f));
+}
+
+static inline TARGET_AVX2 __m256 fixedPhaseToFloat8(__m256i phase)
+{
+    __m256 top = _mm256_cvtepi32_ps(_mm256_srli_epi32(phase, 8));
+    return _mm256_mul_ps(top, _mm256_set1_ps(0x1p-24f));
+}
+
+static inline TARGET_SSE2 __m128 fixedPhaseToFloat4(__m128i phase)
+{
+    __m128 top = _mm_cvtepi32_ps(_mm_srli_epi32(phase, 8));
+    return _mm_mul_ps(top, _mm_set1_ps(0x1p-24f));
+}
+#endif
+
+// One pass over dsp_kernels.h per instruction set; each yields a DspKernels
+// table named dsp_kernels_<isa>.
+#define DSP_ISA scalar
+#define DSP_WIDTH 1
+#define DSP_TARGET
+#include "dsp_kernels.h"
+#undef DSP_ISA
+#undef DSP_WIDTH
+#undef DSP_TARGET
+
+#if defined(HAS_X86_KERNELS)
+#define DSP_ISA sse2
+#define DSP_WIDTH 4
+#define DSP_TARGET TARGET_SSE2
+#include "dsp_kernels.h"
+#undef DSP_ISA
+#undef DSP_WIDTH
+#undef DSP_TARGET
+
+#define DSP_ISA avx2
+#define DSP_WIDTH 8
+#define DSP_TARGET TARGET_AVX2
+#include "dsp_kernels.h"
+#undef DSP_ISA
+#undef DSP_WIDTH
+#undef DSP_TARGET
+
+#define DSP_ISA avx512
+#define DSP_WIDTH 16
+#define DSP_TARGET TARGET_AVX512
+#include "dsp_kernels.h"
+#undef DSP_ISA
+#undef DSP_WIDTH
+#undef DSP_TARGET
+#endif
+
+#pragma GCC pop_options
+#ifdef __clang__
+#pragma STDC FP_CONTRACT DEFAULT
+#endif
+
+// Every build in this binary, in order of preference. AVX2 goes ahead of
+// AVX-512: with slices this short the 16-wide build renders a 24-voice chord
+// about 20% slower, so it is only used when asked for by name. The scalar
+// build runs anywhere and is the reference the others are checked against.
+const DspKernels *const DSP_KERNEL_BUILDS[] = {
+#if defined(HAS_X86_KERNELS)
+    &dsp_kernels_avx2,
+    &dsp_kernels_avx512,
+    &dsp_kernels_sse2,
+#endif
+    &dsp_kernels_scalar,
+};
+#define DSP_KERNEL_BUILDS_LENGTH                                               \
+    (sizeof(DSP_KERNEL_BUILDS) / sizeof(DSP_KERNEL_BUILDS[0]))
+
+// Whether this CPU and OS can run `dsp`. __builtin_cpu_supports reads cpuid
+// and also checks that the OS saves the wider registers.
+bool isDspKernelsSupported(const DspKernels *dsp)
+{
+#if defined(HAS_X86_KERNELS)
+    __builtin_cpu_init();
+    if (dsp == &dsp_kernels_avx512)
+        return __builtin_cpu_supports("avx512f") &&
+               __builtin_cpu_supports("fma");
+    if (dsp == &dsp_kernels_avx2)
+        return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+    if (dsp == &dsp_kernels_sse2)
+        return __builtin_cpu_supports("sse2");
+#endif
+    return dsp == &dsp_kernels_scalar;
+}
+
+// The build called `name`, or the first supported one when `name` is NULL.
+// NULL if there is no such build or this CPU cannot run it.
+const DspKernels *selectDspKernels(const char *name)
+{
+    for (size_t i = 0; i < DSP_KERNEL_BUILDS_LENGTH; i++)
+    {
+        const DspKernels *dsp = DSP_KERNEL_BUILDS[i];
+        if (name != NULL && strcmp(name, dsp->name) != 0)
+            continue;
+        return isDspKernelsSupported(dsp) ? dsp : NULL;
+    }
+    return NULL;
+}
+
+// Pick the specialized renderer for this voice and slice.
+void renderVoice(OscillatorArray *group, size_t slot, const float *mod_buf,
+                 float mod_ratio, size_t frames, int sample_rate)
+{
+    const bool is_amp_ramp = group->amp[slot] != group->amp_target[slot];
+    group->dsp->voice[group->shape][group->alias_quality[slot]]
+                     [mod_buf != NULL][is_amp_ramp](group, slot, mod_buf,
+                                                    mod_ratio, frames,
+                                                    sample_rate);
+}
+
+// Render `count` unmodulated voices from slot `first` in lockstep; see
+// renderVoiceBatch in dsp_kernels.h.
+void renderVoiceBatch(OscillatorArray *group, size_t first, size_t count,
+                      size_t frames, int sample_rate)
+{
+    group->dsp->render_batch(group, first, count, frames, sample_rate);
+}
+
+// Length of the run of voices from `first` that can share a batch: not
+// culled, no FM input, below Nyquist, not minBLEP (it keeps per-voice state),
+// and the same shape_parm as the first.
+size_t findVoiceBatch(Synth *synth, size_t group_i, size_t first)
+{
+    const OscillatorArray *group = &synth->osc_groups[group_i];
+    const float nyquist = synth->sample_rate / 2.0f;
+    size_t count = 0;
+    for (size_t slot = first; slot < group->count; slot++)
+    {
+        float mod_ratio;
+        int voice = (int)(group_i * NUM_OSCILLATORS + slot);
+        if (group->is_culled[slot])
+            break;
+        if (findModulatorBuf(synth, voice, &mod_ratio) != NULL)
+            break;
+        if (group->freq[slot] > nyquist || group->freq[slot] < -nyquist)
+            break;
+        if (group->shape_parm_0[slot] != group->shape_parm_0[first])
+            break;
+        if (group->amp[slot] != group->amp_target[slot])
+            break;
+        if (group->alias_quality[slot] != group->alias_quality[first])
+            break;
+        if (isMinBlepVoice(group, slot))
+            break;
+        count++;
+    }
+    return count;
+}
+
+void updateOscArray(Synth *synth, size_t group_i, size_t frames)
+{
+    OscillatorArray *osc_array = &synth->osc_groups[group_i];
+    size_t slot = 0;
+    while (slot < osc_array->count)
+    {
+        if (osc_array->is_culled[slot])
+        {
+            slot++;
+            continue;
+        }
+        size_t batch = findVoiceBatch(synth, group_i, slot);
+        if (batch >= VOICE_BATCH_MIN)
+        {
+            renderVoiceBatch(osc_array, slot, batch, frames,
+                             synth->sample_rate);
+            slot += batch;
+            continue;
+        }
+
+        float mod_ratio = 0.0f;
+        int voice = (int)(group_i * NUM_OSCILLATORS + slot);
+        const float *mod_buf = findModulatorBuf(synth, voice, &mod_ratio);
+        renderVoice(osc_array, slot, mod_buf, mod_ratio, frames,
+                    synth->sample_rate);
+        slot++;
+    }
+}
+
+void accumOscToSignal(Synth *synth, float *signal, size_t frames)
+{
+    for (size_t i = 0; i < synth->osc_groups_count; i++)
+    {
+        OscillatorArray *osc_array = &synth->osc_groups[i];
+        for (size_t osc_i = 0; osc_i < osc_array->count; osc_i++)
+        {
+            if (osc_array->is_mod[osc_i] || osc_array->is_culled[osc_i])
+                continue;
+
+            synth->dsp->mix(signal, osc_array->buf[osc_i], frames);
+        }
+    }
+}
+
+// A full group makes room by cutting the stolen voice that has faded the
+// furthest. Only happens when notes are stolen faster than they fade.
+void cutFadingVoice(OscillatorArray *group)
+{
+    int quietest = -1;
+    for (size_t slot = 0; slot < group->count; slot++)
+    {
+        if (group->env_stage[slot] == EnvFade &&
+            (quietest < 0 || group->env[slot] < group->env[quietest]))
+            quietest = (int)slot;
+    }
+    if (quietest >= 0)
+        removeVoice(group, (size_t)quietest);
+}
+
+// Start the voice of patch oscillator `patch_i` for `note`, from phase zero
+// at the top of its attack. Dropped when its group is full.
+void startVoice(Synth *synth, size_t patch_i, const HeldNote *note)
+{
+    const PatchGraph *graph =
+        &synth->graph_exchange.buf[synth->graph_exchange.front];
+    const PatchOsc *patch_osc = &graph->osc[patch_i];
+    const OscParams *params = &synth->osc_params[patch_i];
+    if (patch_osc->shape >= WaveCount)
+        return;
+    OscillatorArray *group = &synth->osc_groups[patch_osc->shape];
+    if (group->count >= NUM_OSCILLATORS)
+        cutFadingVoice(group);
+    int slot = insertVoice(group, patch_i);
+    if (slot < 0)
+        return;
+
+    group->phase[slot] = 0.0f;
+    group->phase_acc[slot] = 0;
+    group->phase_dt[slot] = 0.0f;
+    if (patch_osc->is_kb_enabled)
+        group->freq[slot] = midi2freq(note->midi);
+    else
+        group->freq[slot] = params->freq;
+    group->amp[slot] = params->amp;
+    group->amp_target[slot] = params->amp;
+    group->shape_parm_0[slot] = params->shape_parm_0;
+    group->alias_quality[slot] = patch_osc->alias_quality;
+    clearMinBlep(group, slot);
+    group->mod_pair[slot] = -1;
+    group->is_mod[slot] = false;
+    group->ui_id[slot] = patch_i;
+    group->midi[slot] = note->midi;
+    group->note_id[slot] = note->note_id;
+    setVoiceEnvelope(group, slot, params, synth->sample_rate);
+    group->env[slot] = 0.0f;
+    enterEnvStage(group, slot, EnvAttack);
+}
+
+bool hasVoice(const Synth *synth, size_t patch_i, WaveShape shape,
+              size_t note_id)
+{
+    const OscillatorArray *group = &synth->osc_groups[shape];
+    for (size_t slot = 0; slot < group->count; slot++)
+    {
+        if (group->ui_id[slot] == patch_i && group->note_id[slot] == note_id)
+            return true;
+    }
+    return false;
+}
+
+// Pair each carrier with the voice of its modulating oscillator that plays
+// the same note, and silence every voice of a modulating oscillator. Voice
+// numbers change whenever slots shift, so this reruns after every change to
+// the pool; it also flags the job graph for a rebuild.
+void linkModulators(Synth *synth)
+{
+    const PatchGraph *graph =
+        &synth->graph_exchange.buf[synth->graph_exchange.front];
+
+    synth->mod_pair_array.count = 0;
+    for (size_t group_i = 0; group_i < synth->osc_groups_count; group_i++)
+    {
+        OscillatorArray *group = &synth->osc_groups[group_i];
+        for (size_t slot = 0; slot < group->count; slot++)
+        {
+            group->mod_pair[slot] = -1;
+            group->is_mod[slot] = false;
+        }
+    }
+
+    for (size_t group_i = 0; group_i < synth->osc_groups_count; group_i++)
+    {
+        OscillatorArray *group = &synth->osc_groups[group_i];
+        for (size_t slot = 0; slot < group->count; slot++)
+        {
+            // Voices of a dropped oscillator, until applyPatchGraph runs.
+            if (group->ui_id[slot] >= graph->count)
+                continue;
+            int mod_src = graph->osc[group->ui_id[slot]].mod_src;
+            if (mod_src < 0)
+                continue;
+
+            group->mod_pair[slot] = (int)synth->mod_pair_array.count;
+            ModulationPair *mod_pair =
+                synth->mod_pair_array.data + synth->mod_pair_array.count++;
+            mod_pair->modulator = -1;
+            mod_pair->carrier = (int)(group_i * NUM_OSCILLATORS + slot);
+            mod_pair->mod_id = (size_t)mod_src;
+            mod_pair->mod_ratio = 100.0f;
+
+            WaveShape mod_shape = graph->osc[mod_src].shape;
+            OscillatorArray *mod_group = &synth->osc_groups[mod_shape];
+            for (size_t mod_slot = 0; mod_slot < mod_group->count; mod_slot++)
+            {
+                if (mod_group->ui_id[mod_slot] != (size_t)mod_src)
+                    continue;
+                mod_group->is_mod[mod_slot] = true;
+                if (mod_group->note_id[mod_slot] == group->note_id[slot])
+                    mod_pair->modulator =
+                        (int)(mod_shape * NUM_OSCILLATORS + mod_slot);
+            }
+        }
+    }
+
+    synth->is_job_graph_dirty = true;
+}
+
+// A note that counts against the polyphony limit: held, or still sounding
+// its release. Stolen notes no longer count.
+typedef struct SoundingNote
+{
+    size_t note_id;
+    int midi;
+    bool is_released;
+    float level; // loudest voice, amplitude times envelope
+} SoundingNote;
+
+#define MAX_SOUNDING_NOTES (MAX_HELD_NOTES + WaveCount * NUM_OSCILLATORS)
+
+size_t listSoundingNotes(const Synth *synth, SoundingNote *notes)
+{
+    size_t count = 0;
+    for (size_t note_i = 0; note_i < synth->held_count; note_i++)
+    {
+        notes[count++] = (SoundingNote){
+            .note_id = synth->held_notes[note_i].note_id,
+            .midi = synth->held_notes[note_i].midi,
+        };
+    }
+    for (size_t group_i = 0; group_i < synth->osc_groups_count; group_i++)
+    {
+        const OscillatorArray *group = &synth->osc_groups[group_i];
+        for (size_t slot = 0; slot < group->count; slot++)
+        {
+            if (group->env_stage[slot] >= EnvFade)
+                continue;
+            const size_t note_id = group->note_id[slot];
+            size_t note_i = 0;
+            while (note_i < count && notes[note_i].note_id != note_id)
+                note_i++;
+            if (note_i == count)
+            {
+                notes[count++] = (SoundingNote){
+                    .note_id = note_id,
+                    .midi = group->midi[slot],
+                    .is_released = true,
+                };
+            }
+            const float level = fabsf(group->amp[slot] * group->env[slot]);
+            if (level > notes[note_i].level)
+                notes[note_i].level = level;
+        }
+    }
+    return count;
+}
+
+// The note to steal under `policy` for a new note of key `midi`, or -1 when
+// nothing sounds.
+int pickStolenNote(const SoundingNote *notes, size_t count, StealPolicy policy,
+                   int midi)
+{
+    int victim = -1;
+    for (size_t note_i = 0; note_i < count; note_i++)
+    {
+        const SoundingNote *note = &notes[note_i];
+        if (victim < 0)
+        {
+            victim = (int)note_i;
+            continue;
+        }
+        const SoundingNote *best = &notes[victim];
+        bool is_better = note->note_id < best->note_id; // older
+        switch (policy)
+        {
+        case StealRelease:
+            if (note->is_released != best->is_released)
+                is_better = note->is_released;
+            break;
+        case StealQuietest:
+            if (note->level != best->level)
+                is_better = note->level < best->level;
+            break;
+        case StealSameNote:
+            if ((note->midi == midi) != (best->midi == midi))
+                is_better = note->midi == midi;
+            break;
+        default:
+            break;
+        }
+        if (is_better)
+            victim = (int)note_i;
+    }
+    return victim;
+}
+
+// Fade out every voice of `note_id` over STEAL_FADE_SECONDS, and forget the
+// note if it is still held.
+void stealNote(Synth *synth, size_t note_id)
+{
+    for (size_t note_i = 0; note_i < synth->held_count; note_i++)
+    {
+        if (synth->held_notes[note_i].note_id != note_id)
+            continue;
+        memmove(synth->held_notes + note_i, synth->held_notes + note_i + 1,
+                (synth->held_count - note_i - 1) * sizeof(HeldNote));
+        synth->held_count--;
+        break;
+    }
+
+    for (size_t group_i = 0; group_i < synth->osc_groups_count; group_i++)
+    {
+        OscillatorArray *group = &synth->osc_groups[group_i];
+        for (size_t slot = 0; slot < group->count; slot++)
+        {
+            if (group->note_id[slot] != note_id ||
+                group->env_stage[slot] >= EnvFade)
+                continue;
+            group->release_mul[slot] = synth->steal_fade_mul;
+            enterEnvStage(group, slot, EnvFade);
+        }
+    }
+}
+
+// Steal notes until a new note of key `midi` fits: within the polyphony
+// limit, and with a free slot for each of its voices. Under StealSameNote a
+// sounding note of the same key is always taken over.
+void makeRoomForNote(Synth *synth, int midi)
+{
+    const PatchGraph *graph =
+        &synth->graph_exchange.buf[synth->graph_exchange.front];
+    size_t needed[WaveCount] = {0};
+    for (size_t patch_i = 0; patch_i < graph->count; patch_i++)
+    {
+        if (graph->osc[patch_i].shape < WaveCount)
+            needed[graph->osc[patch_i].shape]++;
+    }
+
+    SoundingNote notes[MAX_SOUNDING_NOTES];
+    bool is_retriggered = synth->steal_policy != StealSameNote;
+    for (;;)
+    {
+        const size_t count = listSoundingNotes(synth, notes);
+        bool is_full = count >= synth->polyphony ||
+                       synth->held_count >= MAX_HELD_NOTES;
+        for (size_t group_i = 0; group_i < synth->osc_groups_count; group_i++)
+        {
+            size_t live = 0;
+            const OscillatorArray *group = &synth->osc_groups[group_i];
+            for (size_t slot = 0; slot < group->count; slot++)
+                live += group->env_stage[slot] < EnvFade;
+            is_full |= live + needed[group_i] > NUM_OSCILLATORS;
+        }
+
+        int victim = pickStolenNote(notes, count, synth->steal_policy, midi);
+        if (!is_retriggered)
+        {
+            is_retriggered = true;
+            if (victim >= 0 && notes[victim].midi == midi)
+                is_full = true;
+        }
+        if (!is_full || victim < 0)
+            return;
+        stealNote(synth, notes[victim].note_id);
+    }
+}
+
+// A new note gets one voice per patch oscillator; the voices already
+// sounding keep their state. Notes are stolen first to stay within the
+// polyphony limit.
+void noteOn(Synth *synth, int midi)
+{
+    const PatchGraph *graph =
+        &synth->graph_exchange.buf[synth->graph_exchange.front];
+    makeRoomForNote(synth, midi);
+    if (synth->held_count >= MAX_HELD_NOTES)
+        return;
+
+    HeldNote *note = &synth->held_notes[synth->held_count++];
+    note->midi = midi;
+    note->note_id = synth->next_note_id++;
+    for (size_t patch_i = 0; patch_i < graph->count; patch_i++)
+        startVoice(synth, patch_i, note);
+    linkModulators(synth);
+}
+
+// Releases the oldest held instance of `midi`. Its voices play out their
+// release and are retired once it ends.
+void noteOff(Synth *synth, int midi)
+{
+    size_t note_i = 0;
+    while (note_i < synth->held_count &&
+           synth->held_notes[note_i].midi != midi)
+        note_i++;
+    if (note_i == synth->held_count)
+        return;
+
+    const size_t note_id = synth->held_notes[note_i].note_id;
+    memmove(synth->held_notes + note_i, synth->held_notes + note_i + 1,
+            (synth->held_count - note_i - 1) * sizeof(HeldNote));
+    synth->held_count--;
+
+    for (size_t group_i = 0; group_i < synth->osc_groups_count; group_i++)
+    {
+        OscillatorArray *group = &synth->osc_groups[group_i];
+        for (size_t slot = 0; slot < group->count; slot++)
+        {
+            if (group->note_id[slot] == note_id &&
+                group->env_stage[slot] < EnvRelease)
+                enterEnvStage(group, slot, EnvRelease);
+        }
+    }
+}
+
+// Drop the voices whose release has ended.
+void retireVoices(Synth *synth)
+{
+    bool is_removed = false;
+    for (size_t group_i = 0; group_i < synth->osc_groups_count; group_i++)
+    {
+        OscillatorArray *group = &synth->osc_groups[group_i];
+        if (group->env_off_count == 0)
+            continue;
+        for (size_t slot = group->count; slot-- > 0;)
+        {
+            if (group->env_stage[slot] == EnvOff)
+                removeVoice(group, slot);
+        }
+        group->env_off_count = 0;
+        is_removed = true;
+    }
+    if (is_removed)
+        linkModulators(synth);
+}
+
+// A continuous parameter goes straight to the voices of its UIOsc. Amplitude
+// changes ramp over the next slice. Envelope changes reload the running
+// stage, so a sustaining voice moves to the new sustain level at once.
+void setOscParam(Synth *synth, size_t ui_id, SynthParam param, float value)
+{
+    const OscParams *params = &synth->osc_params[ui_id];
+    const PatchGraph *graph =
+        &synth->graph_exchange.buf[synth->graph_exchange.front];
+    const bool is_kb_enabled =
+        ui_id < graph->count && graph->osc[ui_id].is_kb_enabled;
+
+    for (size_t group_i = 0; group_i < synth->osc_groups_count; group_i++)
+    {
+        OscillatorArray *group = &synth->osc_groups[group_i];
+        for (size_t slot = 0; slot < group->count; slot++)
+        {
+            if (group->ui_id[slot] != ui_id)
+                continue;
+            switch (param)
+            {
+            case ParamFreq:
+                if (!is_kb_enabled)
+                    group->freq[slot] = value;
+                break;
+            case ParamAmp:
+                group->amp_target[slot] = value;
+                break;
+            case ParamShapeParm:
+                group->shape_parm_0[slot] = value;
+                break;
+            case ParamAttack:
+            case ParamDecay:
+            case ParamSustain:
+            case ParamRelease:
+                if (group->env_stage[slot] == EnvFade)
+                    break;
+                setVoiceEnvelope(group, slot, params, synth->sample_rate);
+                // A held note glides to a new sustain level over the decay
+                // time instead of jumping to it.
+                if (group->env_stage[slot] == EnvSustain)
+                    enterEnvStage(group, slot, EnvDecay);
+                else
+                    enterEnvStage(group, slot, group->env_stage[slot]);
+                break;
+            }
+        }
+    }
+}
+
+void applyEvent(Synth *synth, const SynthEvent *ev)
+{
+    switch (ev->type)
+    {
+    case EventNoteOn:
+        if (ev->midi >= 0 && ev->midi < MIDI_NOTE_COUNT)
+            noteOn(synth, ev->midi);
+        break;
+    case EventNoteOff:
+        noteOff(synth, ev->midi);
+        break;
+    case EventParamSet:
+    {
+        if (ev->ui_id >= MAX_UI_OSC)
+            break;
+        OscParams *params = &synth->osc_params[ev->ui_id];
+        switch (ev->param)
+        {
+        case ParamFreq:
+            params->freq = ev->value;
+            break;
+        case ParamAmp:
+            params->amp = ev->value;
+            break;
+        case ParamShapeParm:
+            params->shape_parm_0 = ev->value;
+            break;
+        case ParamAttack:
+            params->attack = ev->value;
+            break;
+        case ParamDecay:
+            params->decay = ev->value;
+            break;
+        case ParamSustain:
+            params->sustain = ev->value;
+            break;
+        case ParamRelease:
+            params->release = ev->value;
+            break;
+        }
+        setOscParam(synth, ev->ui_id, ev->param, ev->value);
+        break;
+    }
+    }
+}
+
+// Bring the voice pool in line with a newly acquired patch graph. Voices of
+// oscillators that are gone or changed shape stop; the rest keep their phase
+// and pick up the structural fields. Held notes then get voices for the
+// oscillators that have none yet. Only ever called from the renderer.
+void applyPatchGraph(Synth *synth)
+{
+    const PatchGraph *graph =
+        &synth->graph_exchange.buf[synth->graph_exchange.front];
+
+    for (size_t group_i = 0; group_i < synth->osc_groups_count; group_i++)
+    {
+        OscillatorArray *group = &synth->osc_groups[group_i];
+        for (size_t slot = group->count; slot-- > 0;)
+        {
+            const size_t ui_id = group->ui_id[slot];
+            if (ui_id >= graph->count ||
+                graph->osc[ui_id].shape != (WaveShape)group_i)
+            {
+                removeVoice(group, slot);
+                continue;
+            }
+            const PatchOsc *patch_osc = &graph->osc[ui_id];
+            if (group->alias_quality[slot] != patch_osc->alias_quality)
+                clearMinBlep(group, slot);
+            group->alias_quality[slot] = patch_osc->alias_quality;
+            if (patch_osc->is_kb_enabled)
+                group->freq[slot] = midi2freq(group->midi[slot]);
+            else
+                group->freq[slot] = synth->osc_params[ui_id].freq;
+        }
+    }
+
+    for (size_t note_i = 0; note_i < synth->held_count; note_i++)
+    {
+        const HeldNote *note = &synth->held_notes[note_i];
+        for (size_t patch_i = 0; patch_i < graph->count; patch_i++)
+        {
+            const WaveShape shape = graph->osc[patch_i].shape;
+            if (shape < WaveCount &&
+                !hasVoice(synth, patch_i, shape, note->note_id))
+                startVoice(synth, patch_i, note);
+        }
+    }
+
+    linkModulators(synth);
+    synth->is_graph_dirty = false;
+}
+
+// Apply every queued event that is due at the current render frame.
+void drainEvents(Synth *synth)
+{
+    SynthEvent ev;
+    while (peekEvent(&synth->event_queue, &ev) &&
+           ev.frame <= synth->render_frame)
+    {
+        popEvent(&synth->event_queue, &ev);
+        applyEvent(synth, &ev);
+    }
+    if (synth->is_graph_dirty)
+        applyPatchGraph(synth);
+}
+
+////////////////////////////////////////////////////////////////
+
+void initJobDeque(JobDeque *deque)
+{
+    atomic_init(&deque->top, 0);
+    atomic_init(&deque->bottom, 0);
+    for (size_t i = 0; i < JOB_DEQUE_CAPACITY; i++)
+        atomic_init(&deque->jobs[i], -1);
+}
+
+// Owner only.
+void pushJob(JobDeque *deque, int job)
+{
+    long bottom = atomic_load_explicit(&deque->bottom, memory_order_relaxed);
+    atomic_store_explicit(&deque->jobs[bottom & (JOB_DEQUE_CAPACITY - 1)], job,
+                          memory_order_relaxed);
+    atomic_store_explicit(&deque->bottom, bottom + 1, memory_order_release);
+}
+
+// Owner only. Returns -1 when empty or when a thief won the last job.
+int popJob(JobDeque *deque)
+{
+    long bottom =
+        atomic_load_explicit(&deque->bottom, memory_order_relaxed) - 1;
+    atomic_store_explicit(&deque->bottom, bottom, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+    long top = atomic_load_explicit(&deque->top, memory_order_relaxed);
+
+    if (top > bottom)
+    {
+        atomic_store_explicit(&deque->bottom, bottom + 1, memory_order_relaxed);
+        return -1;
+    }
+
+    int job = atomic_load_explicit(
+        &deque->jobs[bottom & (JOB_DEQUE_CAPACITY - 1)], memory_order_relaxed);
+    if (top == bottom)
+    {
+        if (!atomic_compare_exchange_strong_explicit(&deque->top, &top, top + 1,
+                                                     memory_order_seq_cst,
+                                                     memory_order_relaxed))
+            job = -1;
+        atomic_store_explicit(&deque->bottom, bottom + 1, memory_order_relaxed);
+    }
+    return job;
+}
+
+// Any thread. Returns -1 when empty or when the race for the top was lost.
+int stealJob(JobDeque *deque)
+{
+    long top = atomic_load_explicit(&deque->top, memory_order_acquire);
+    atomic_thread_fence(memory_order_seq_cst);
+    long bottom = atomic_load_explicit(&deque->bottom, memory_order_acquire);
+    if (top >= bottom)
+        return -1;
+
+    int job = atomic_load_explicit(&deque->jobs[top & (JOB_DEQUE_CAPACITY - 1)],
+                                   memory_order_relaxed);
+    if (!atomic_compare_exchange_strong_explicit(&deque->top, &top, top + 1,
+                                                 memory_order_seq_cst,
+                                                 memory_order_relaxed))
+        return -1;
+    return job;
+}
+
+void runJob(RenderPool *pool, size_t self, int job_i)
+{
+    VoiceJob *job = &pool->jobs[job_i];
+    if (job->count > 1)
+        renderVoiceBatch(job->group, job->first, job->count, pool->frames,
+                         pool->sample_rate);
+    else
+        renderVoice(job->group, job->first, job->mod_buf, job->mod_ratio,
+                    pool->frames, pool->sample_rate);
+
+    for (size_t i = 0; i < job->succ_count; i++)
+    {
+        size_t succ = pool->succ[job->succ_start + i];
+        if (atomic_fetch_sub_explicit(&pool->pred_left[succ], 1,
+                                      memory_order_acq_rel) == 1)
+            pushJob(&pool->deques[self], (int)succ);
+    }
+    atomic_fetch_sub_explicit(&pool->jobs_left, 1, memory_order_acq_rel);
+}
+
+// Busy-wait step: pause the core, and give the CPU away once in a while in
+// case there are more render threads than free cores.
+void spinWait(unsigned *spins)
+{
+#if defined(__SSE__)
+    _mm_pause();
+#endif
+    if (++*spins % SPINS_BEFORE_YIELD == 0)
+        sched_yield();
+}
+
+// Pop local work, otherwise steal round-robin, until the slice is done.
+void workOnSlice(RenderPool *pool, size_t self)
+{
+    unsigned spins = 0;
+    while (atomic_load_explicit(&pool->jobs_left, memory_order_acquire) > 0)
+    {
+        int job = popJob(&pool->deques[self]);
+        for (size_t k = 1; job < 0 && k < pool->worker_count; k++)
+            job = stealJob(&pool->deques[(self + k) % pool->worker_count]);
+        if (job >= 0)
+            runJob(pool, self, job);
+        else
+            spinWait(&spins);
+    }
+}
+
+void *renderWorkerMain(void *arg)
+{
+    RenderWorker *worker = (RenderWorker *)arg;
+    RenderPool *pool = worker->pool;
+
+    // Must match the render thread, or results would differ on denormals.
+    enableDenormalFlush();
+    if (pool->is_rt_priority_requested)
+    {
+        int priority = sched_get_priority_max(SCHED_FIFO) - 1;
+        if (priority > RT_FIFO_PRIORITY)
+            priority = RT_FIFO_PRIORITY;
+        struct sched_param param = {.sched_priority = priority};
+        pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+    }
+
+    while (true)
+    {
+        pthread_mutex_lock(&pool->mutex);
+        while (atomic_load(&pool->is_running) &&
+               !atomic_load(&pool->is_block_active))
+            pthread_cond_wait(&pool->cond, &pool->mutex);
+        pthread_mutex_unlock(&pool->mutex);
+        if (!atomic_load(&pool->is_running))
+            break;
+
+        unsigned spins = 0;
+        while (atomic_load_explicit(&pool->is_block_active,
+                                    memory_order_acquire))
+        {
+            workOnSlice(pool, worker->index);
+            spinWait(&spins);
+        }
+    }
+    return NULL;
+}
+
+RenderPool *createRenderPool(size_t thread_count, int sample_rate,
+                             bool is_rt_priority_requested)
+{
+    RenderPool *pool = (RenderPool *)aligned_alloc(_Alignof(RenderPool),
+                                                   sizeof(RenderPool));
+    memset(pool, 0, sizeof(RenderPool));
+    pool->worker_count = thread_count;
+    pool->sample_rate = sample_rate;
+    pool->is_rt_priority_requested = is_rt_priority_requested;
+    atomic_init(&pool->jobs_left, 0);
+    atomic_init(&pool->is_block_active, false);
+    atomic_init(&pool->is_running, true);
+    pthread_mutex_init(&pool->mutex, NULL);
+    pthread_cond_init(&pool->cond, NULL);
+    for (size_t i = 0; i < MAX_VOICES; i++)
+        atomic_init(&pool->pred_left[i], 0);
+    for (size_t i = 0; i < thread_count; i++)
+    {
+        initJobDeque(&pool->deques[i]);
+        pool->workers[i].pool = pool;
+        pool->workers[i].index = i;
+    }
+
+    // Worker 0 is whichever thread calls renderAudio.
+    for (size_t i = 1; i < thread_count; i++)
+    {
+        if (pthread_create(&pool->workers[i].thread, NULL, renderWorkerMain,
+                           &pool->workers[i]) != 0)
+        {
+            pool->worker_count = i;
+            break;
+        }
+    }
+    return pool;
+}
+
+void destroyRenderPool(RenderPool *pool)
+{
+    pthread_mutex_lock(&pool->mutex);
+    atomic_store(&pool->is_running, false);
+    pthread_cond_broadcast(&pool->cond);
+    pthread_mutex_unlock(&pool->mutex);
+    for (size_t i = 1; i < pool->worker_count; i++)
+        pthread_join(pool->workers[i].thread, NULL);
+    pthread_mutex_destroy(&pool->mutex);
+    pthread_cond_destroy(&pool->cond);
+    free(pool);
+}
+
+// Wake the workers for the duration of a block. Between blocks they sleep on
+// the condition variable; the mutex is only held long enough to flip the
+// flag, never while rendering.
+void beginPoolBlock(RenderPool *pool)
+{
+    pthread_mutex_lock(&pool->mutex);
+    atomic_store(&pool->is_block_active, true);
+    pthread_cond_broadcast(&pool->cond);
+    pthread_mutex_unlock(&pool->mutex);
+}
+
+void endPoolBlock(RenderPool *pool)
+{
+    atomic_store(&pool->is_block_active, false);
+}
+
+// Number the voices in serial render order, batching them the same way as
+// updateOscArray, and link each carrier with its modulator. Culled voices get
+// no job. In serial order a carrier reads the modulator's current slice
+// when the modulator renders earlier, and its previous slice when it renders
+// later. Each edge therefore points from the earlier job to the later one,
+// which keeps the graph acyclic and the output identical to serial rendering.
+void buildJobGraph(Synth *synth)
+{
+    RenderPool *pool = synth->pool;
+    size_t job_of[WaveCount][NUM_OSCILLATORS];
+    size_t edge_from[MAX_VOICES];
+    size_t edge_to[MAX_VOICES];
+    size_t edge_count = 0;
+
+    pool->job_count = 0;
+    for (size_t group_i = 0; group_i < synth->osc_groups_count; group_i++)
+    {
+        OscillatorArray *osc_array = &synth->osc_groups[group_i];
+        size_t slot = 0;
+        while (slot < osc_array->count)
+        {
+            if (osc_array->is_culled[slot])
+            {
+                job_of[group_i][slot++] = SIZE_MAX;
+                continue;
+            }
+            VoiceJob job = {.group = osc_array, .first = slot, .count = 1};
+            size_t batch = findVoiceBatch(synth, group_i, slot);
+            if (batch >= VOICE_BATCH_MIN)
+                job.count = batch;
+            else
+                job.mod_buf = findModulatorBuf(
+                    synth, (int)(group_i * NUM_OSCILLATORS + slot),
+                    &job.mod_ratio);
+
+            for (size_t i = 0; i < job.count; i++)
+                job_of[group_i][slot + i] = pool->job_count;
+            pool->jobs[pool->job_count++] = job;
+            slot += job.count;
+        }
+    }
+
+    for (size_t job_i = 0; job_i < pool->job_count; job_i++)
+    {
+        const VoiceJob *job = &pool->jobs[job_i];
+        const OscillatorArray *group = job->group;
+        int pair_i = (job->count == 1) ? group->mod_pair[job->first] : -1;
+        if (pair_i < 0)
+            continue;
+        int modulator = synth->mod_pair_array.data[pair_i].modulator;
+        if (modulator < 0)
+            continue;
+        size_t mod_job = job_of[modulator / NUM_OSCILLATORS]
+                               [modulator % NUM_OSCILLATORS];
+        if (mod_job == job_i || mod_job == SIZE_MAX)
+            continue;
+        edge_from[edge_count] = (mod_job < job_i) ? mod_job : job_i;
+        edge_to[edge_count] = (mod_job < job_i) ? job_i : mod_job;
+        edge_count++;
+        pool->jobs[edge_to[edge_count - 1]].pred_count++;
+    }
+
+    size_t succ_start = 0;
+    for (size_t job_i = 0; job_i < pool->job_count; job_i++)
+    {
+        VoiceJob *job = &pool->jobs[job_i];
+        job->succ_start = succ_start;
+        for (size_t edge_i = 0; edge_i < edge_count; edge_i++)
+        {
+            if (edge_from[edge_i] == job_i)
+                pool->succ[succ_start + job->succ_count++] = edge_to[edge_i];
+        }
+        succ_start += job->succ_count;
+    }
+
+    synth->is_job_graph_dirty = false;
+}
+
+// Render one slice of every voice on the pool. Mixing stays serial, in the
+// same order as accumOscToSignal, so the sum is bit-identical.
+void renderSliceParallel(Synth *synth, size_t frames)
+{
+    RenderPool *pool = synth->pool;
+    if (synth->is_job_graph_dirty)
+        buildJobGraph(synth);
+
+    pool->frames = frames;
+    for (size_t job_i = 0; job_i < pool->job_count; job_i++)
+        atomic_store_explicit(&pool->pred_left[job_i],
+                              pool->jobs[job_i].pred_count,
+                              memory_order_relaxed);
+    atomic_store_explicit(&pool->jobs_left, (int)pool->job_count,
+                          memory_order_release);
+
+    for (size_t job_i = pool->job_count; job_i-- > 0;)
+    {
+        if (pool->jobs[job_i].pred_count == 0)
+            pushJob(&pool->deques[0], (int)job_i);
+    }
+    workOnSlice(pool, 0);
+}
+
+size_t countVoices(const Synth *synth)
+{
+    size_t count = 0;
+    for (size_t i = 0; i < synth->osc_groups_count; i++)
+        count += synth->osc_groups[i].count;
+    return count;
+}
+
+// Skip the voices too quiet to hear in the next `frames` samples. Outside the
+// attack a voice's level only falls or holds, or rises in a decay to a raised
+// sustain, so its level now or its decay goal bounds the slice. Released voices are retired for good; the others sleep, phase
+// frozen, until their amplitude or sustain comes back up. A culled modulator
+// feeds its carrier silence.
+void cullVoices(Synth *synth, size_t frames)
+{
+    unsigned culled = 0;
+    size_t retired = 0;
+    for (size_t group_i = 0; group_i < synth->osc_groups_count; group_i++)
+    {
+        OscillatorArray *group = &synth->osc_groups[group_i];
+        for (size_t slot = 0; slot < group->count; slot++)
+        {
+            const float amp = fmaxf(fabsf(group->amp[slot]),
+                                    fabsf(group->amp_target[slot]));
+            const EnvStage stage = group->env_stage[slot];
+            const float env = (stage == EnvDecay)
+                                  ? fmaxf(group->env[slot],
+                                          group->env_goal[slot])
+                                  : group->env[slot];
+            const bool is_culled =
+                stage != EnvAttack && amp * env < synth->cull_level;
+            if (is_culled != group->is_culled[slot])
+                synth->is_job_graph_dirty = true;
+            group->is_culled[slot] = is_culled;
+            if (!is_culled)
+                continue;
+
+            culled++;
+            if (stage == EnvRelease || stage == EnvFade)
+            {
+                group->env[slot] = 0.0f;
+                enterEnvStage(group, slot, EnvOff);
+                group->env_off_count++;
+                retired++;
+            }
+            if (group->is_mod[slot])
+                memset(group->buf[slot], 0, frames * sizeof(float));
+        }
+    }
+    atomic_store_explicit(&synth->stats.culled_voices, culled,
+                          memory_order_relaxed);
+    if (retired > 0)
+        atomic_fetch_add_explicit(&synth->stats.culled_retire_count, retired,
+                                  memory_order_relaxed);
+}
+
+// Render `frames` samples into `signal`, slice by slice. A slice is cut short
+// at the next queued event, so every event lands on its exact frame.
+void renderSlices(Synth *synth, float *signal, size_t frames)
+{
+    size_t t = 0;
+    while (t < frames)
+    {
+        drainEvents(synth);
+
+        size_t slice = frames - t;
+        if (slice > synth->slice_size)
+            slice = synth->slice_size;
+        // An event that is already due, e.g. one the UI thread pushed with
+        // frame 0 after drainEvents, is left to the next drainEvents pass.
+        SynthEvent next;
+        if (peekEvent(&synth->event_queue, &next) &&
+            next.frame > synth->render_frame &&
+            next.frame < synth->render_frame + slice)
+            slice = next.frame - synth->render_frame;
+
+        cullVoices(synth, slice);
+        for (size_t i = 0; i < synth->osc_groups_count; i++)
+            synth->dsp->envelopes(&synth->osc_groups[i], slice);
+
+        if (synth->pool != NULL && countVoices(synth) >= PARALLEL_MIN_VOICES)
+        {
+            renderSliceParallel(synth, slice);
+        }
+        else
+        {
+            for (size_t i = 0; i < synth->osc_groups_count; i++)
+                updateOscArray(synth, i, slice);
+        }
+
+        accumOscToSignal(synth, signal + t, slice);
+        retireVoices(synth);
+
+        t += slice;
+        synth->render_frame += slice;
+    }
+}
+
+// Render `frames` samples into `out`, in chunks no larger than a block.
+// `synth->signal` is left holding the last chunk for the scope. The graph is
+// acquired before any events are drained: the UI queues parameters before it
+// publishes a graph, so every event that belongs with that graph is visible.
+void renderAudio(Synth *synth, float *out, size_t frames)
+{
+    const double audio_frame_start_time = nowSeconds();
+    const size_t block_frames = frames;
+
+    if (acquireGraph(&synth->graph_exchange))
+        synth->is_graph_dirty = true;
+    if (synth->pool != NULL)
+        beginPoolBlock(synth->pool);
+
+    while (frames > 0)
+    {
+        const size_t chunk =
+            (frames < synth->signal_length) ? frames : synth->signal_length;
+        zeroSignal(synth->signal, synth->signal_length);
+        renderSlices(synth, synth->signal, chunk);
+
+        if (out != synth->signal)
+            memcpy(out, synth->signal, chunk * sizeof(float));
+        writeScopeRing(&synth->scope_ring, synth->signal, chunk);
+        out += chunk;
+        frames -= chunk;
+    }
+
+    if (synth->pool != NULL)
+        endPoolBlock(synth->pool);
+
+    recordBlockStats(&synth->stats, nowSeconds() - audio_frame_start_time,
+                     (double)block_frames / synth->sample_rate);
+}
+
+// Push mode: refill the stream from the render loop when raylib asks for it.
+void handleAudioStream(AudioStream stream, Synth *synth)
+{
+    if (IsAudioStreamProcessed(stream))
+    {
+        // Every queued buffer played out before this refill: the device ran
+        // dry for at least part of the gap.
+        const double now = nowSeconds();
+        const double buffered_seconds = (double)AUDIO_STREAM_BUFFERS *
+                                        synth->signal_length /
+                                        synth->sample_rate;
+        if (synth->stats.last_refill_time > 0.0 &&
+            now - synth->stats.last_refill_time > buffered_seconds)
+            atomic_fetch_add_explicit(&synth->stats.xrun_count, 1,
+                                      memory_order_relaxed);
+        synth->stats.last_refill_time = now;
+
+        renderAudio(synth, synth->signal, synth->signal_length);
+        UpdateAudioStream(stream, synth->signal, synth->signal_length);
+    }
+}
+
+// Pull mode: raylib's audio thread asks for samples directly. AudioCallback
+// carries no user pointer, so the synth is reached through a global.
+static Synth *audio_callback_synth = NULL;
+
+void audioStreamCallback(void *buffer_data, unsigned int frames)
+{
+    if (!audio_callback_synth->is_render_thread_prepared)
+        prepareRenderThread(audio_callback_synth);
+    renderAudio(audio_callback_synth, (float *)buffer_data, frames);
+}
+
+void drawSignal(Synth *synth)
+{
+    // Keep the previous picture if the read raced with the render thread.
+    size_t length = readScopeRing(&synth->scope_ring, synth->scope_snapshot,
+                                  SCOPE_SAMPLES);
+    if (length > 0)
+        synth->scope_length = length;
+    const float *signal = synth->scope_snapshot;
+    const size_t signal_length = synth->scope_length;
+
+    // Draw signal
+    size_t zero_crossing_idx = 0;
+    for (size_t i = 1; i < signal_length; i++)
+    {
+        if (signal[i] >= 0.0f && signal[i - 1] < 0.0f)
+        {
+            zero_crossing_idx = i;
+            break;
+        }
+    }
+
+    Vector2 *signal_points = synth->scope_points;
+    const float screen_vert_midpoint = (float)(SCREEN_HEIGHT) / 2;
+    for (size_t p_i = 0; p_i < signal_length; p_i++)
+    {
+        const size_t signal_idx = (p_i + zero_crossing_idx) % signal_length;
+        signal_points[p_i].x = (float)p_i + LEFT_PANEL_WIDTH;
+        signal_points[p_i].y =
+            screen_vert_midpoint + (int)(signal[signal_idx] * 100);
+    }
+
+    DrawLineStrip(signal_points, signal_length - zero_crossing_idx, YELLOW);
+}
+
+// Audio load overlay: last block, rolling stats, xruns, the render-time
+// histogram as bars (each bin is 5% of the block deadline), and culling.
+void drawAudioStats(Synth *synth)
+{
+    AudioStatsSnapshot stats;
+    getAudioStats(&synth->stats, &stats);
+
+    const int x = LEFT_PANEL_WIDTH + 10;
+    DrawText(TextFormat("Audio load: %5.1f%%  xruns: %u", stats.load * 100.0f,
+                        stats.xrun_count),
+             x, 70, 16, RED);
+    DrawText(TextFormat("min %.1f%%  avg %.1f%%  p99 %.1f%%  max %.1f%%",
+                        stats.load_min * 100.0f, stats.load_avg * 100.0f,
+                        stats.load_p99 * 100.0f, stats.load_max * 100.0f),
+             x, 90, 16, RED);
+    DrawText(TextFormat("culled voices: %u  retired early: %zu",
+                        stats.culled_voices, stats.culled_retire_count),
+             x, 150, 16, RED);
+
+    unsigned max_count = 1;
+    for (size_t i = 0; i < STATS_HISTOGRAM_BINS; i++)
+    {
+        if (stats.histogram[i] > max_count)
+            max_count = stats.histogram[i];
+    }
+    const int bar_width = 8;
+    const int bar_max_height = 30;
+    const int bar_bottom = 140;
+    for (size_t i = 0; i < STATS_HISTOGRAM_BINS; i++)
+    {
+        int height = (int)((float)stats.histogram[i] / max_count *
+                           bar_max_height);
+        if (stats.histogram[i] > 0 && height == 0)
+            height = 1;
+        Color color = (i == STATS_HISTOGRAM_BINS - 1) ? RED : YELLOW;
+        DrawRectangle(x + (int)i * (bar_width + 2), bar_bottom - height,
+                      bar_width, height, color);
+    }
+}
+
+void draw_ui(Synth *synth)
+{
+    const int panel_x_start = 0;
     const int panel_y_start = 0;
     const int panel_width = LEFT_PANEL_WIDTH;
     const int panel_height = SCREEN_WIDTH;
@@ -389,217 +3304,1179 @@ void draw_ui(Synth *synth)
         ui_osc->freq = BASE_NOTE_FREQ;
         ui_osc->amp = 0.5f;
         ui_osc->shape_parm_0 = 0.5f;
+        ui_osc->alias_quality = AliasPolyBlep;
+        ui_osc->attack = ENV_DEFAULT_ATTACK;
+        ui_osc->decay = ENV_DEFAULT_DECAY;
+        ui_osc->sustain = ENV_DEFAULT_SUSTAIN;
+        ui_osc->release = ENV_DEFAULT_RELEASE;
         ui_osc->is_kb_enabled = true;
     }
 
-    float panel_y_offset = 0;
-    for (size_t ui_osc_i = 0; ui_osc_i < synth->ui_osc_count; ui_osc_i++)
+    float panel_y_offset = 0;
+    for (size_t ui_osc_i = 0; ui_osc_i < synth->ui_osc_count; ui_osc_i++)
+    {
+        UIOsc *ui_osc = &synth->ui_osc[ui_osc_i];
+        const bool has_shape_param =
+            (ui_osc->shape == WaveSqr || ui_osc->shape == WaveRsq ||
+             ui_osc->shape == WaveTbl);
+        const bool has_alias_quality =
+            (ui_osc->shape == WaveSaw || ui_osc->shape == WaveSqr);
+
+        const int osc_panel_width = panel_width - 20;
+        const int osc_panel_height =
+            130 + (has_shape_param ? 30 : 0) + (has_alias_quality ? 30 : 0);
+        const int osc_panel_x = panel_x_start + 10;
+        const int osc_panel_y = panel_y_start + 50 + panel_y_offset;
+        panel_y_offset += osc_panel_height + 5;
+        GuiPanel((Rectangle){osc_panel_x, osc_panel_y, osc_panel_width,
+                             osc_panel_height},
+                 NULL);
+
+        const float slider_padding = 50.f;
+        const float el_spacing = 5.f;
+        Rectangle el_rect = {.x = osc_panel_x + slider_padding + 30,
+                             .y = osc_panel_y + 10,
+                             .width =
+                                 osc_panel_width - (slider_padding * 2) - 20,
+                             .height = 25};
+
+        // Frequency slider
+        char freq_slider_label[16];
+        sprintf(freq_slider_label, "%.1fHz", ui_osc->freq);
+        float log_freq = log10f(ui_osc->freq);
+        GuiSlider(el_rect, freq_slider_label, "", &log_freq, 0.0f,
+                  log10f((float)(synth->sample_rate / 2.0f)));
+        ui_osc->freq = powf(10.f, log_freq);
+        // Reset button
+        Rectangle reset_btn_rect = el_rect;
+        reset_btn_rect.x = osc_panel_width - 20 - el_spacing;
+        reset_btn_rect.width = 30;
+        bool reset_freq = GuiButton(reset_btn_rect, "R");
+        if (reset_freq)
+            ui_osc->freq = BASE_NOTE_FREQ;
+        el_rect.y += el_rect.height + el_spacing;
+
+        // Amplitude slider
+        float decibels = (20.f * log10f(ui_osc->amp));
+        char amp_slider_label[32];
+        sprintf(amp_slider_label, "%.1f dB", decibels);
+        GuiSlider(el_rect, amp_slider_label, "", &decibels, -60.0f, 0.0f);
+        ui_osc->amp = powf(10.f, decibels * (1.f / 20.f));
+        el_rect.y += el_rect.height + el_spacing;
+
+        // Envelope sliders. Times use a square law up to ENV_MAX_SECONDS, so
+        // short ones get most of the travel; sustain is a plain level.
+        float *env_params[4] = {&ui_osc->attack, &ui_osc->decay,
+                                &ui_osc->sustain, &ui_osc->release};
+        const char *env_labels[4] = {"A", "D", "S", "R"};
+        const float env_row_x = osc_panel_x + 25;
+        const float env_cell_width =
+            (el_rect.x + el_rect.width - env_row_x) / 4.0f;
+        for (size_t i = 0; i < 4; i++)
+        {
+            const bool is_time = (env_params[i] != &ui_osc->sustain);
+            Rectangle env_rect = el_rect;
+            env_rect.x = env_row_x + env_cell_width * i;
+            env_rect.width = env_cell_width - 20;
+            const float value = is_time
+                                    ? sqrtf(*env_params[i] / ENV_MAX_SECONDS)
+                                    : *env_params[i];
+            float slider = value;
+            GuiSlider(env_rect, env_labels[i], "", &slider, 0.0f, 1.0f);
+            // Only write back on a drag: the square root does not round trip.
+            if (slider != value)
+                *env_params[i] =
+                    is_time ? slider * slider * ENV_MAX_SECONDS : slider;
+        }
+        el_rect.y += el_rect.height + el_spacing;
+
+        // Shape parameter slider
+        if (has_shape_param)
+        {
+            float shape_param = ui_osc->shape_parm_0;
+            char shape_param_label[32];
+            sprintf(shape_param_label, "%.1f", shape_param);
+            GuiSlider(el_rect, shape_param_label, "", &shape_param, 0.f, 1.f);
+            ui_osc->shape_parm_0 = shape_param;
+            el_rect.y += el_rect.height + el_spacing;
+        }
+
+        // Defer anti-aliasing drop-down box.
+        if (has_alias_quality)
+        {
+            ui_osc->alias_dropdown_rect = el_rect;
+            el_rect.y += el_rect.height + el_spacing;
+        }
+
+        // Defer shape drop-down box.
+        ui_osc->shape_dropdown_rect = el_rect;
+        el_rect.y += el_rect.height + el_spacing;
+
+        Rectangle delete_button_rect = el_rect;
+        delete_button_rect.x = osc_panel_x + 5;
+        delete_button_rect.y -= el_rect.height + el_spacing;
+        delete_button_rect.width = 30;
+        bool is_delete_button_pressed = GuiButton(delete_button_rect, "X");
+        if (is_delete_button_pressed)
+        {
+            memmove(synth->ui_osc + ui_osc_i, synth->ui_osc + ui_osc_i + 1,
+                    (synth->ui_osc_count - ui_osc_i) * sizeof(UIOsc));
+            synth->ui_osc_count -= 1;
+        }
+
+        // Mod button
+        Rectangle mod_btn_rect = delete_button_rect;
+        mod_btn_rect.x += 40;
+        const char *mod_btn_text = (ui_osc->mod_state == 0)
+                                       ? "N/A"
+                                       : TextFormat("%d", ui_osc->mod_state);
+        bool mod_btn_pressed = GuiButton(mod_btn_rect, mod_btn_text);
+        if (mod_btn_pressed)
+        {
+            ui_osc->mod_state = (ui_osc->mod_state + 1) % 8;
+        }
+
+        // Keyboard enable button
+        Rectangle kb_enable_btn_rect = delete_button_rect;
+        kb_enable_btn_rect.x = osc_panel_width - 20 - el_spacing;
+        kb_enable_btn_rect.width = 30;
+        GuiToggle(kb_enable_btn_rect, "ON", &ui_osc->is_kb_enabled);
+    }
+
+    for (size_t ui_osc_i = 0; ui_osc_i < synth->ui_osc_count; ui_osc_i++)
+    {
+        UIOsc *ui_osc = &synth->ui_osc[ui_osc_i];
+        // Shape select
+        int shape_index = (int)(ui_osc->shape);
+        bool is_dropdown_click =
+            GuiDropdownBox(ui_osc->shape_dropdown_rect, WAVE_SHAPE_OPTIONS,
+                           &shape_index, ui_osc->is_dropdown_open);
+        ui_osc->shape = (WaveShape)(shape_index);
+        if (is_dropdown_click)
+        {
+            ui_osc->is_dropdown_open = !ui_osc->is_dropdown_open;
+        }
+
+        // Anti-aliasing select, drawn after the shape box its list covers.
+        if (ui_osc->shape == WaveSaw || ui_osc->shape == WaveSqr)
+        {
+            int alias_index = (int)(ui_osc->alias_quality);
+            bool is_alias_dropdown_click = GuiDropdownBox(
+                ui_osc->alias_dropdown_rect, ALIAS_QUALITY_OPTIONS,
+                &alias_index, ui_osc->is_alias_dropdown_open);
+            ui_osc->alias_quality = (AliasQuality)(alias_index);
+            if (is_alias_dropdown_click)
+            {
+                ui_osc->is_alias_dropdown_open =
+                    !ui_osc->is_alias_dropdown_open;
+            }
+        }
+        if (ui_osc->is_dropdown_open || ui_osc->is_alias_dropdown_open)
+            break;
+    }
+}
+
+// Queue one parameter of a UIOsc if it changed since it was last sent.
+void publishParam(EventQueue *queue, size_t ui_id, SynthParam param,
+                  float *sent, float value)
+{
+    if (*sent == value)
+        return;
+    SynthEvent ev = {.type = EventParamSet,
+                     .ui_id = ui_id,
+                     .param = param,
+                     .value = value};
+    if (pushEvent(queue, ev))
+        *sent = value;
+}
+
+// Compare the UIOsc panels against what the renderer was last told: queue
+// parameter changes, then publish a new patch graph if the layout changed.
+// Parameters that do not fit in the queue stay unpublished and are retried on
+// the next call.
+void publishPatch(Synth *synth)
+{
+    EventQueue *queue = &synth->event_queue;
+
+    for (size_t ui_osc_i = 0; ui_osc_i < synth->ui_osc_count; ui_osc_i++)
+    {
+        UIOsc *ui_osc = &synth->ui_osc[ui_osc_i];
+        OscParams *sent = &synth->ui_params_sent[ui_osc_i];
+        publishParam(queue, ui_osc_i, ParamFreq, &sent->freq, ui_osc->freq);
+        publishParam(queue, ui_osc_i, ParamAmp, &sent->amp, ui_osc->amp);
+        publishParam(queue, ui_osc_i, ParamShapeParm, &sent->shape_parm_0,
+                     ui_osc->shape_parm_0);
+        publishParam(queue, ui_osc_i, ParamAttack, &sent->attack,
+                     ui_osc->attack);
+        publishParam(queue, ui_osc_i, ParamDecay, &sent->decay, ui_osc->decay);
+        publishParam(queue, ui_osc_i, ParamSustain, &sent->sustain,
+                     ui_osc->sustain);
+        publishParam(queue, ui_osc_i, ParamRelease, &sent->release,
+                     ui_osc->release);
+    }
+
+    // Structural changes: rebuild the whole layout off to the side and publish
+    // it in one swap.
+    PatchGraph graph;
+    memset(&graph, 0, sizeof(graph)); // padding too, for the memcmp below
+    graph.count = synth->ui_osc_count;
+    for (size_t ui_osc_i = 0; ui_osc_i < synth->ui_osc_count; ui_osc_i++)
+    {
+        UIOsc *ui_osc = &synth->ui_osc[ui_osc_i];
+        PatchOsc *patch_osc = &graph.osc[ui_osc_i];
+        patch_osc->shape = ui_osc->shape;
+        patch_osc->alias_quality = ui_osc->alias_quality;
+        patch_osc->is_kb_enabled = ui_osc->is_kb_enabled;
+        patch_osc->mod_src = -1;
+        if (ui_osc->mod_state > 0 &&
+            (size_t)(ui_osc->mod_state - 1) < synth->ui_osc_count)
+            patch_osc->mod_src = ui_osc->mod_state - 1;
+    }
+    if (memcmp(&graph, &synth->ui_graph_sent, sizeof(graph)) != 0)
+    {
+        *beginGraph(&synth->graph_exchange) = graph;
+        publishGraph(&synth->graph_exchange);
+        synth->ui_graph_sent = graph;
+    }
+}
+
+// Queue note on/off for keyboard changes since the last frame, then publish
+// the patch.
+void apply_ui_state(Synth *synth)
+{
+    EventQueue *queue = &synth->event_queue;
+    bool octave_up = IsKeyDown(KEY_LEFT_SHIFT) || IsKeyDown(KEY_RIGHT_SHIFT);
+
+    for (size_t k = 0; k < KEYS_LENGTH; k++)
+    {
+        int midi = -1;
+        if (IsKeyDown(KEYS[k].k))
+            midi = KEYS[k].midi + (12 * (int)octave_up);
+
+        int *sent_midi = &synth->ui_key_midi[k];
+        if (*sent_midi == midi)
+            continue;
+        if (*sent_midi >= 0)
+        {
+            if (!pushEvent(queue,
+                           (SynthEvent){.type = EventNoteOff, .midi = *sent_midi}))
+                continue;
+            *sent_midi = -1;
+        }
+        if (midi >= 0 &&
+            pushEvent(queue, (SynthEvent){.type = EventNoteOn, .midi = midi}))
+            *sent_midi = midi;
+    }
+
+    publishPatch(synth);
+}
+
+// The first oscillator's pitch, from UI state only: the lowest key held if
+// it follows the keyboard, else its own frequency.
+float uiFundamentalFreq(const Synth *synth)
+{
+    if (synth->ui_osc_count == 0)
+        return 0.0f;
+    const UIOsc *ui_osc = &synth->ui_osc[0];
+    int lowest_midi = -1;
+    for (size_t k = 0; k < KEYS_LENGTH; k++)
+    {
+        const int midi = synth->ui_key_midi[k];
+        if (midi >= 0 && (lowest_midi < 0 || midi < lowest_midi))
+            lowest_midi = midi;
+    }
+    if (ui_osc->is_kb_enabled && lowest_midi >= 0)
+        return midi2freq((float)lowest_midi);
+    return ui_osc->freq;
+}
+
+Synth *createSynth(EngineMode engine_mode, EngineConfig config)
+{
+    Synth *synth = (Synth *)aligned_alloc(_Alignof(Synth), sizeof(Synth));
+    memset(synth, 0, sizeof(Synth));
+
+    synth->osc_groups_count = WaveCount;
+    synth->dsp = selectDspKernels(config.kernels);
+    synth->signal = (float *)calloc(config.block_size, sizeof(float));
+    synth->signal_length = config.block_size;
+    synth->slice_size = config.slice_size;
+    synth->sample_rate = config.sample_rate;
+    synth->polyphony =
+        (config.polyphony > 0) ? config.polyphony : DEFAULT_POLYPHONY;
+    synth->steal_policy = config.steal_policy;
+    synth->steal_fade_mul = envCoef(STEAL_FADE_SECONDS, ENV_DECAY_UNDERSHOOT,
+                                    config.sample_rate);
+    synth->cull_level = powf(10.0f, config.cull_db / 20.0f);
+    initScopeRing(&synth->scope_ring, config.block_size);
+    synth->scope_snapshot = (float *)calloc(SCOPE_SAMPLES, sizeof(float));
+    synth->scope_points = (Vector2 *)calloc(SCOPE_SAMPLES, sizeof(Vector2));
+
+    // One slice-sized buffer per oscillator slot, all in one allocation.
+    synth->osc_buf_pool = (float *)calloc(
+        WaveCount * NUM_OSCILLATORS * config.slice_size, sizeof(float));
+    for (size_t group_i = 0; group_i < WaveCount; group_i++)
+    {
+        for (size_t osc_i = 0; osc_i < NUM_OSCILLATORS; osc_i++)
+        {
+            size_t slot = group_i * NUM_OSCILLATORS + osc_i;
+            synth->osc_groups[group_i].buf[osc_i] =
+                synth->osc_buf_pool + slot * config.slice_size;
+        }
+        synth->osc_groups[group_i].is_fixed_phase = config.is_fixed_phase;
+        synth->osc_groups[group_i].shape = (WaveShape)group_i;
+        synth->osc_groups[group_i].dsp = synth->dsp;
+    }
+
+    synth->osc_groups[WaveSin].count = 0;
+    synth->osc_groups[WaveSaw].count = 0;
+    synth->osc_groups[WaveTri].count = 0;
+    synth->osc_groups[WaveSqr].count = 0;
+    synth->osc_groups[WaveRsq].count = 0;
+    synth->osc_groups[WaveTbl].count = 0;
+    initWaveTables();
+    initMinBlepTable();
+
+    synth->mod_pair_array.count = 0;
+    synth->engine_mode = engine_mode;
+
+    // ui_params_sent and osc_params both start zeroed, so the UI's diff and
+    // the renderer's copy agree before the first event.
+    for (size_t k = 0; k < KEYS_LENGTH; k++)
+        synth->ui_key_midi[k] = -1;
+    initEventQueue(&synth->event_queue);
+    initGraphExchange(&synth->graph_exchange);
+
+    synth->is_rt_priority_requested = config.is_rt_priority_requested;
+    atomic_init(&synth->is_rt_status_ready, false);
+    atomic_init(&synth->stats.block_count, 0);
+    atomic_init(&synth->stats.xrun_count, 0);
+    atomic_init(&synth->stats.culled_voices, 0);
+    atomic_init(&synth->stats.culled_retire_count, 0);
+
+    size_t render_threads = config.render_threads;
+    if (render_threads == 0)
+        render_threads = (size_t)sysconf(_SC_NPROCESSORS_ONLN);
+    if (render_threads > MAX_RENDER_THREADS)
+        render_threads = MAX_RENDER_THREADS;
+    if (render_threads > 1)
+        synth->pool = createRenderPool(render_threads, synth->sample_rate,
+                                       config.is_rt_priority_requested);
+
+    return synth;
+}
+
+void destroySynth(Synth *synth)
+{
+    if (synth->pool != NULL)
+        destroyRenderPool(synth->pool);
+    free(synth->osc_buf_pool);
+    freeScopeRing(&synth->scope_ring);
+    free(synth->scope_snapshot);
+    free(synth->scope_points);
+    free(synth->signal);
+    free(synth);
+}
+
+////////////////////////////////////////////////////////////////
+
+typedef struct TimedEvent
+{
+    size_t frame;
+    SynthEvent ev;
+} TimedEvent;
+
+int compareTimedEvents(const void *a, const void *b)
+{
+    const TimedEvent *ev_a = (const TimedEvent *)a;
+    const TimedEvent *ev_b = (const TimedEvent *)b;
+    if (ev_a->frame != ev_b->frame)
+        return (ev_a->frame < ev_b->frame) ? -1 : 1;
+    // Releases first, so a note retriggered on the same frame stays held.
+    return (int)(ev_b->ev.type == EventNoteOff) -
+           (int)(ev_a->ev.type == EventNoteOff);
+}
+
+// Patch file: one oscillator per line,
+//   <shape> <freq> <amp> <shape_parm> <kb_enabled> <mod_state>
+//   [alias [attack decay sustain release]]
+// where shape is an index or one of WAVE_SHAPE_NAMES, and alias one of
+// ALIAS_QUALITY_NAMES (PolyBLEP when omitted). The envelope times are in
+// seconds. '#' starts a comment.
+bool loadPatchFile(Synth *synth, const char *path)
+{
+    FILE *file = fopen(path, "r");
+    if (file == NULL)
+    {
+        fprintf(stderr, "Cannot open patch file %s\n", path);
+        return false;
+    }
+
+    char line[256];
+    synth->ui_osc_count = 0;
+    while (fgets(line, sizeof(line), file) && synth->ui_osc_count < MAX_UI_OSC)
+    {
+        char shape_name[16];
+        char alias_name[16] = "blep";
+        UIOsc ui_osc = {.attack = ENV_DEFAULT_ATTACK,
+                        .decay = ENV_DEFAULT_DECAY,
+                        .sustain = ENV_DEFAULT_SUSTAIN,
+                        .release = ENV_DEFAULT_RELEASE};
+        int kb_enabled = 1;
+        int fields = sscanf(line, "%15s %f %f %f %d %d %15s %f %f %f %f",
+                            shape_name, &ui_osc.freq, &ui_osc.amp,
+                            &ui_osc.shape_parm_0, &kb_enabled,
+                            &ui_osc.mod_state, alias_name, &ui_osc.attack,
+                            &ui_osc.decay, &ui_osc.sustain, &ui_osc.release);
+        if (fields < 3 || shape_name[0] == '#')
+            continue;
+
+        int shape = -1;
+        for (int i = 0; i < WaveCount; i++)
+        {
+            if (strcmp(shape_name, WAVE_SHAPE_NAMES[i]) == 0)
+                shape = i;
+        }
+        if (shape < 0)
+            sscanf(shape_name, "%d", &shape);
+        if (shape < 0 || shape >= WaveCount)
+        {
+            fprintf(stderr, "Unknown shape '%s' in %s\n", shape_name, path);
+            continue;
+        }
+
+        int alias_quality = -1;
+        for (int i = 0; i < AliasQualityCount; i++)
+        {
+            if (strcmp(alias_name, ALIAS_QUALITY_NAMES[i]) == 0)
+                alias_quality = i;
+        }
+        if (alias_quality < 0)
+        {
+            fprintf(stderr, "Unknown anti-aliasing '%s' in %s\n", alias_name,
+                    path);
+            continue;
+        }
+
+        ui_osc.shape = (WaveShape)shape;
+        ui_osc.alias_quality = (AliasQuality)alias_quality;
+        ui_osc.is_kb_enabled = kb_enabled != 0;
+        synth->ui_osc[synth->ui_osc_count++] = ui_osc;
+    }
+
+    fclose(file);
+    return true;
+}
+
+// Note file: one note per line, <start_seconds> <duration_seconds> <midi>.
+// Returns note on/off events sorted by frame, or NULL on error.
+TimedEvent *loadNoteFile(const char *path, int sample_rate,
+                         size_t *event_count, size_t *end_frame)
+{
+    FILE *file = fopen(path, "r");
+    if (file == NULL)
+    {
+        fprintf(stderr, "Cannot open note file %s\n", path);
+        return NULL;
+    }
+
+    size_t capacity = 64;
+    TimedEvent *events = (TimedEvent *)malloc(capacity * sizeof(TimedEvent));
+    *event_count = 0;
+    *end_frame = 0;
+
+    char line[256];
+    while (fgets(line, sizeof(line), file))
+    {
+        float start, duration;
+        int midi;
+        if (line[0] == '#' ||
+            sscanf(line, "%f %f %d", &start, &duration, &midi) != 3)
+            continue;
+        if (start < 0.0f || duration < 0.0f || midi < 0 ||
+            midi >= MIDI_NOTE_COUNT)
+            continue;
+
+        if (*event_count + 2 > capacity)
+        {
+            capacity *= 2;
+            events = (TimedEvent *)realloc(events,
+                                           capacity * sizeof(TimedEvent));
+        }
+        size_t on_frame = (size_t)(start * sample_rate);
+        size_t off_frame = (size_t)((start + duration) * sample_rate);
+        events[(*event_count)++] = (TimedEvent){
+            on_frame, {.type = EventNoteOn, .midi = midi}};
+        events[(*event_count)++] = (TimedEvent){
+            off_frame, {.type = EventNoteOff, .midi = midi}};
+        if (off_frame > *end_frame)
+            *end_frame = off_frame;
+    }
+
+    fclose(file);
+    qsort(events, *event_count, sizeof(TimedEvent), compareTimedEvents);
+    return events;
+}
+
+// Offline render: no window, no audio device. The patch and notes go through
+// the same queue and graph exchange as the UI, and blocks are rendered back to
+// back as fast as the CPU allows.
+int renderHeadless(EngineConfig config, const char *patch_path,
+                   const char *notes_path, const char *wav_path)
+{
+    Synth *synth = createSynth(EnginePush, config);
+    if (!loadPatchFile(synth, patch_path))
+    {
+        destroySynth(synth);
+        return 1;
+    }
+
+    size_t event_count, end_frame;
+    TimedEvent *events = loadNoteFile(notes_path, synth->sample_rate,
+                                      &event_count, &end_frame);
+    if (events == NULL)
     {
-        UIOsc *ui_osc = &synth->ui_osc[ui_osc_i];
-        const bool has_shape_param =
-            (ui_osc->shape == WaveSqr || ui_osc->shape == WaveRsq);
+        destroySynth(synth);
+        return 1;
+    }
 
-        const int osc_panel_width = panel_width - 20;
-        const int osc_panel_height = has_shape_param ? 130 : 100;
-        const int osc_panel_x = panel_x_start + 10;
-        const int osc_panel_y = panel_y_start + 50 + panel_y_offset;
-        panel_y_offset += osc_panel_height + 5;
-        GuiPanel((Rectangle){osc_panel_x, osc_panel_y, osc_panel_width,
-                             osc_panel_height},
-                 NULL);
+    // Rendering goes on past the last note until every release has ended.
+    const size_t max_frames =
+        end_frame + (size_t)(RENDER_MAX_TAIL_SECONDS * synth->sample_rate);
+    float *out = (float *)calloc(max_frames, sizeof(float));
 
-        const float slider_padding = 50.f;
-        const float el_spacing = 5.f;
-        Rectangle el_rect = {.x = osc_panel_x + slider_padding + 30,
-                             .y = osc_panel_y + 10,
-                             .width =
-                                 osc_panel_width - (slider_padding * 2) - 20,
-                             .height = 25};
+    publishPatch(synth);
 
-        // Frequency slider
-        char freq_slider_label[16];
-        sprintf(freq_slider_label, "%.1fHz", ui_osc->freq);
-        float log_freq = log10f(ui_osc->freq);
-        GuiSlider(el_rect, freq_slider_label, "", &log_freq, 0.0f,
-                  log10f((float)(SAMPLE_RATE / 2.0f)));
-        ui_osc->freq = powf(10.f, log_freq);
-        // Reset button
-        Rectangle reset_btn_rect = el_rect;
-        reset_btn_rect.x = osc_panel_width - 20 - el_spacing;
-        reset_btn_rect.width = 30;
-        bool reset_freq = GuiButton(reset_btn_rect, "R");
-        if (reset_freq)
-            ui_osc->freq = BASE_NOTE_FREQ;
-        el_rect.y += el_rect.height + el_spacing;
+    lockEngineMemory(synth);
+    prepareRenderThread(synth);
+    printRtStatus(synth);
 
-        // Amplitude slider
-        float decibels = (20.f * log10f(ui_osc->amp));
-        char amp_slider_label[32];
-        sprintf(amp_slider_label, "%.1f dB", decibels);
-        GuiSlider(el_rect, amp_slider_label, "", &decibels, -60.0f, 0.0f);
-        ui_osc->amp = powf(10.f, decibels * (1.f / 20.f));
-        el_rect.y += el_rect.height + el_spacing;
+    const double start_time = nowSeconds();
+    size_t next_event = 0;
+    size_t total_frames = 0;
+    while (total_frames < max_frames)
+    {
+        const size_t frame = total_frames;
+        size_t block = max_frames - frame;
+        if (block > synth->signal_length)
+            block = synth->signal_length;
 
-        // Shape parameter slider
-        if (has_shape_param)
+        // Queue everything due within this block; the renderer applies each
+        // event on its exact frame. Whatever does not fit goes in later.
+        while (next_event < event_count &&
+               events[next_event].frame < frame + block)
         {
-            float shape_param = ui_osc->shape_parm_0;
-            char shape_param_label[32];
-            sprintf(shape_param_label, "%.1f", shape_param);
-            GuiSlider(el_rect, shape_param_label, "", &shape_param, 0.f, 1.f);
-            ui_osc->shape_parm_0 = shape_param;
-            el_rect.y += el_rect.height + el_spacing;
+            SynthEvent ev = events[next_event].ev;
+            ev.frame = events[next_event].frame;
+            if (!pushEvent(&synth->event_queue, ev))
+                break;
+            next_event++;
         }
 
-        // Defer shape drop-down box.
-        ui_osc->shape_dropdown_rect = el_rect;
-        el_rect.y += el_rect.height + el_spacing;
+        renderAudio(synth, out + frame, block);
+        total_frames += block;
 
-        Rectangle delete_button_rect = el_rect;
-        delete_button_rect.x = osc_panel_x + 5;
-        delete_button_rect.y -= el_rect.height + el_spacing;
-        delete_button_rect.width = 30;
-        bool is_delete_button_pressed = GuiButton(delete_button_rect, "X");
-        if (is_delete_button_pressed)
-        {
-            memmove(synth->ui_osc + ui_osc_i, synth->ui_osc + ui_osc_i + 1,
-                    (synth->ui_osc_count - ui_osc_i) * sizeof(UIOsc));
-            synth->ui_osc_count -= 1;
-        }
+        // Voices are retired once their release reaches EnvOff.
+        SynthEvent ev;
+        if (total_frames > end_frame && next_event == event_count &&
+            !peekEvent(&synth->event_queue, &ev) && countVoices(synth) == 0)
+            break;
+    }
+    const double elapsed = nowSeconds() - start_time;
 
-        // Mod button
-        Rectangle mod_btn_rect = delete_button_rect;
-        mod_btn_rect.x += 40;
-        const char *mod_btn_text = (ui_osc->mod_state == 0)
-                                       ? "N/A"
-                                       : TextFormat("%d", ui_osc->mod_state);
-        bool mod_btn_pressed = GuiButton(mod_btn_rect, mod_btn_text);
-        if (mod_btn_pressed)
-        {
-            ui_osc->mod_state = (ui_osc->mod_state + 1) % 8;
-        }
+    Wave wave = {.frameCount = (unsigned int)total_frames,
+                 .sampleRate = (unsigned int)synth->sample_rate,
+                 .sampleSize = 32,
+                 .channels = 1,
+                 .data = out};
+    bool is_exported = ExportWave(wave, wav_path);
 
-        // Keyboard enable button
-        Rectangle kb_enable_btn_rect = delete_button_rect;
-        kb_enable_btn_rect.x = osc_panel_width - 20 - el_spacing;
-        kb_enable_btn_rect.width = 30;
-        GuiToggle(kb_enable_btn_rect, "ON", &ui_osc->is_kb_enabled);
-    }
+    AudioStatsSnapshot stats;
+    getAudioStats(&synth->stats, &stats);
+    printf("Block load: min %.1f%%, avg %.1f%%, p99 %.1f%%, max %.1f%% of the "
+           "deadline over the last %zu blocks\n",
+           stats.load_min * 100.0f, stats.load_avg * 100.0f,
+           stats.load_p99 * 100.0f, stats.load_max * 100.0f,
+           (stats.block_count < STATS_WINDOW) ? stats.block_count
+                                              : (size_t)STATS_WINDOW);
+    printf("Culled voices: %zu released voices retired early\n",
+           stats.culled_retire_count);
 
-    for (size_t ui_osc_i = 0; ui_osc_i < synth->ui_osc_count; ui_osc_i++)
+    const double audio_seconds = (double)total_frames / synth->sample_rate;
+    printf("Rendered %.2f s of audio in %.3f s (%.1fx realtime)%s%s\n",
+           audio_seconds, elapsed,
+           (elapsed > 0.0) ? audio_seconds / elapsed : 0.0,
+           is_exported ? " to " : ", failed to write ",
+           wav_path);
+
+    free(out);
+    free(events);
+    destroySynth(synth);
+    return is_exported ? 0 : 1;
+}
+
+////////////////////////////////////////////////////////////////
+
+// --selftest: every kernel build this CPU supports against the scalar one,
+// which is the reference. The builds must match it bit for bit.
+#define SELFTEST_FRAMES 1021 // odd, so every SIMD tail runs
+#define SELFTEST_VOICES 12
+#define SELFTEST_BATCH 4 // voices [0, 4) render as a batch, the rest alone
+#define SELFTEST_SLICES 40
+#define SELFTEST_SINE_STEPS 4096 // phases per turn, over several turns
+#define SELFTEST_SINE_MAX_ERROR 2e-7 // sinPoly's bound is about 1.6e-7
+#define SELFTEST_RSQ_MAX_ERROR 4e-6 // rsqKernel is about 2.2e-6 off powf
+#define SELFTEST_TWO_PI 6.28318530717958647692
+
+// Repeatable noise in [0, 1) for test inputs.
+static float selfTestNoise(uint32_t *seed)
+{
+    *seed = *seed * 1664525u + 1013904223u;
+    return (float)(*seed >> 8) * (1.0f / 16777216.0f);
+}
+
+// The larger of two differences; NaN counts as the largest.
+static float worseDiff(float diff, float d)
+{
+    return (d <= diff) ? diff : d;
+}
+
+static float maxAbsDiff(const float *a, const float *b, size_t count)
+{
+    float diff = 0.0f;
+    for (size_t i = 0; i < count; i++)
+        diff = worseDiff(diff, fabsf(a[i] - b[i]));
+    return diff;
+}
+
+// Every waveform kernel at every AliasQuality, over random phases and
+// increments.
+static float selfTestWaves(const DspKernels *dsp, uint32_t *seed)
+{
+    static float phase[SELFTEST_FRAMES], phase_dt[SELFTEST_FRAMES];
+    static float ref[SELFTEST_FRAMES], out[SELFTEST_FRAMES];
+    float diff = 0.0f;
+    for (int shape = 0; shape < WaveCount; shape++)
     {
-        UIOsc *ui_osc = &synth->ui_osc[ui_osc_i];
-        // Shape select
-        int shape_index = (int)(ui_osc->shape);
-        bool is_dropdown_click =
-            GuiDropdownBox(ui_osc->shape_dropdown_rect, WAVE_SHAPE_OPTIONS,
-                           &shape_index, ui_osc->is_dropdown_open);
-        ui_osc->shape = (WaveShape)(shape_index);
-        if (is_dropdown_click)
+        for (int quality = 0; quality < AliasQualityCount; quality++)
         {
-            ui_osc->is_dropdown_open = !ui_osc->is_dropdown_open;
+            const float shape_parm = selfTestNoise(seed);
+            for (size_t t = 0; t < SELFTEST_FRAMES; t++)
+            {
+                phase[t] = selfTestNoise(seed);
+                phase_dt[t] = selfTestNoise(seed) * 0.05f + 1e-5f;
+            }
+            dsp_kernels_scalar.wave[shape][quality](phase, phase_dt,
+                                                    shape_parm, ref,
+                                                    SELFTEST_FRAMES);
+            dsp->wave[shape][quality](phase, phase_dt, shape_parm, out,
+                                      SELFTEST_FRAMES);
+            diff = worseDiff(diff, maxAbsDiff(ref, out, SELFTEST_FRAMES));
         }
-        if (ui_osc->is_dropdown_open)
-            break;
     }
+    return diff;
 }
 
-void apply_ui_state(Synth *synth)
+static float selfTestMix(const DspKernels *dsp, uint32_t *seed)
 {
-    // Reset synth
-    for (size_t i = 0; i < synth->osc_groups_count; i++)
+    static float buf[SELFTEST_FRAMES], ref[SELFTEST_FRAMES];
+    static float out[SELFTEST_FRAMES];
+    for (size_t t = 0; t < SELFTEST_FRAMES; t++)
     {
-        // Clear osc array
-        synth->osc_groups[i].count = 0;
+        buf[t] = selfTestNoise(seed) - 0.5f;
+        ref[t] = out[t] = selfTestNoise(seed) - 0.5f;
     }
-    synth->mod_pair_array.count = 0;
+    dsp_kernels_scalar.mix(ref, buf, SELFTEST_FRAMES);
+    dsp->mix(out, buf, SELFTEST_FRAMES);
+    return maxAbsDiff(ref, out, SELFTEST_FRAMES);
+}
 
-    for (size_t ui_osc_i = 0; ui_osc_i < synth->ui_osc_count; ui_osc_i++)
+// Voices with short random ADSRs, some plain gates, released halfway, over
+// slices of every length.
+static float selfTestEnvelopes(const DspKernels *dsp, uint32_t *seed)
+{
+    static OscillatorArray ref, out;
+    memset(&ref, 0, sizeof(ref));
+    ref.count = NUM_OSCILLATORS - 3; // leaves a partial SIMD step
+    for (size_t slot = 0; slot < ref.count; slot++)
     {
-        UIOsc *ui_osc = &synth->ui_osc[ui_osc_i];
+        OscParams params = {.attack = selfTestNoise(seed) * 0.01f,
+                            .decay = selfTestNoise(seed) * 0.02f,
+                            .sustain = selfTestNoise(seed),
+                            .release = selfTestNoise(seed) * 0.03f};
+        if (slot % 7 == 0)
+            params = (OscParams){.sustain = 1.0f};
+        setVoiceEnvelope(&ref, slot, &params, DEFAULT_SAMPLE_RATE);
+        enterEnvStage(&ref, slot, EnvAttack);
+    }
+    out = ref;
 
-        for (size_t k = 0; k < KEYS_LENGTH; k++)
+    float diff = 0.0f;
+    for (size_t slice = 0; slice < 4 * MAX_SLICE_SIZE; slice++)
+    {
+        const size_t frames = 1 + (slice * 37) % MAX_SLICE_SIZE;
+        if (slice == 2 * MAX_SLICE_SIZE)
         {
-            if (!IsKeyDown(KEYS[k].k))
-                continue;
-            bool octave_up =
-                IsKeyDown(KEY_LEFT_SHIFT) || IsKeyDown(KEY_RIGHT_SHIFT);
-
-            Oscillator *osc = NULL;
-            if (ui_osc->shape < WaveCount)
+            for (size_t slot = 0; slot < ref.count; slot += 2)
             {
-                OscillatorArray *group = &synth->osc_groups[ui_osc->shape];
-                if (group->count < NUM_OSCILLATORS)
-                    osc = makeOscillator(group);
+                enterEnvStage(&ref, slot, EnvRelease);
+                enterEnvStage(&out, slot, EnvRelease);
             }
+        }
+        dsp_kernels_scalar.envelopes(&ref, frames);
+        dsp->envelopes(&out, frames);
+        diff = worseDiff(diff, maxAbsDiff(ref.env_rows[0], out.env_rows[0],
+                                          frames * NUM_OSCILLATORS));
+    }
+    return diff;
+}
 
-            if (osc != NULL)
+// The voice renderers of every shape and AliasQuality, with and without FM
+// and an amplitude ramp, floating and fixed phase, and the batch renderer.
+static float selfTestVoices(const DspKernels *dsp, uint32_t *seed)
+{
+    static OscillatorArray ref, out;
+    static float ref_bufs[SELFTEST_VOICES][MAX_SLICE_SIZE];
+    static float out_bufs[SELFTEST_VOICES][MAX_SLICE_SIZE];
+    float mod_buf[MAX_SLICE_SIZE];
+    float diff = 0.0f;
+    for (int shape = 0; shape < WaveCount; shape++)
+    {
+        for (int quality = 0; quality < AliasQualityCount; quality++)
+        {
+            for (int is_fixed = 0; is_fixed < 2; is_fixed++)
             {
-                float freq;
-                if (ui_osc->is_kb_enabled)
+                memset(&ref, 0, sizeof(ref));
+                ref.shape = (WaveShape)shape;
+                ref.count = SELFTEST_VOICES;
+                ref.is_fixed_phase = is_fixed;
+                for (size_t slot = 0; slot < SELFTEST_VOICES; slot++)
                 {
-                    // float base_freq =
-                    //     midi2freq(KEYS[k].midi + (12 * (int)octave_up));
-                    // freq = base_freq + (ui_osc->freq - BASE_NOTE_FREQ);
-                    freq = midi2freq(KEYS[k].midi + (12 * (int)octave_up));
+                    ref.freq[slot] = 50.0f + selfTestNoise(seed) * 8000.0f;
+                    ref.amp[slot] = 0.5f;
+                    ref.amp_target[slot] = 0.5f;
+                    ref.shape_parm_0[slot] = 0.3f;
+                    ref.alias_quality[slot] = (AliasQuality)quality;
+                    ref.phase[slot] = selfTestNoise(seed);
+                    ref.phase_acc[slot] = *seed;
+                    for (size_t t = 0; t < MAX_SLICE_SIZE; t++)
+                        ref.env_rows[t][slot] = selfTestNoise(seed);
                 }
-                else
+                out = ref;
+                ref.dsp = &dsp_kernels_scalar;
+                out.dsp = dsp;
+                for (size_t slot = 0; slot < SELFTEST_VOICES; slot++)
                 {
-                    freq = ui_osc->freq;
+                    ref.buf[slot] = ref_bufs[slot];
+                    out.buf[slot] = out_bufs[slot];
                 }
 
-                osc->freq = freq;
-                osc->ui_id = ui_osc_i;
-                osc->amp = ui_osc->amp;
-                osc->shape_parm_0 = ui_osc->shape_parm_0;
-                osc->is_mod = false;
-
-                if (ui_osc->mod_state > 0 &&
-                    (ui_osc->mod_state - 1) < synth->ui_osc_count)
+                for (size_t slice = 0; slice < SELFTEST_SLICES; slice++)
                 {
-                    ModulationPair *mod_pair = synth->mod_pair_array.data +
-                                               synth->mod_pair_array.count++;
-                    mod_pair->modulator = 0;
-                    mod_pair->carrier = osc;
-                    mod_pair->mod_id = ui_osc->mod_state - 1;
-                    mod_pair->mod_ratio = 100.0f;
+                    const size_t frames = 17 + slice % SELFTEST_SLICES;
+                    for (size_t t = 0; t < frames; t++)
+                        mod_buf[t] = selfTestNoise(seed) - 0.5f;
+                    if (slice == SELFTEST_SLICES / 4)
+                    {
+                        for (size_t slot = 0; slot < SELFTEST_VOICES; slot++)
+                        {
+                            ref.amp_target[slot] = 0.8f;
+                            out.amp_target[slot] = 0.8f;
+                        }
+                    }
+                    size_t first = 0;
+                    if (!isMinBlepVoice(&ref, 0))
+                    {
+                        renderVoiceBatch(&ref, 0, SELFTEST_BATCH, frames,
+                                         DEFAULT_SAMPLE_RATE);
+                        renderVoiceBatch(&out, 0, SELFTEST_BATCH, frames,
+                                         DEFAULT_SAMPLE_RATE);
+                        first = SELFTEST_BATCH;
+                    }
+                    for (size_t slot = first; slot < SELFTEST_VOICES; slot++)
+                    {
+                        const float *mod = (slot & 1) ? mod_buf : NULL;
+                        renderVoice(&ref, slot, mod, 100.0f, frames,
+                                    DEFAULT_SAMPLE_RATE);
+                        renderVoice(&out, slot, mod, 100.0f, frames,
+                                    DEFAULT_SAMPLE_RATE);
+                    }
+                    for (size_t slot = 0; slot < SELFTEST_VOICES; slot++)
+                    {
+                        diff = worseDiff(diff, maxAbsDiff(ref_bufs[slot],
+                                                          out_bufs[slot],
+                                                          frames));
+                    }
                 }
             }
         }
     }
+    return diff;
+}
 
-    for (size_t mod_i = 0; mod_i < synth->mod_pair_array.count; mod_i++)
+// Largest error of the sine kernel, or with `dsp` NULL of libm's
+// sinf(2 * PI * p), against the double-precision sine of the same phases.
+// Only the scalar kernel is measured: the other builds must match it.
+static double selfTestSine(const DspKernels *dsp)
+{
+    static float phase[SELFTEST_SINE_STEPS], out[SELFTEST_SINE_STEPS];
+    static float phase_dt[SELFTEST_SINE_STEPS]; // unused by the sine
+    double error = 0.0;
+    for (int turn = -3; turn < 4; turn++)
     {
-        ModulationPair *mod_pair = &synth->mod_pair_array.data[mod_i];
-        WaveShape shape_id = synth->ui_osc[mod_pair->mod_id].shape;
-        OscillatorArray *osc_array = &synth->osc_groups[shape_id];
+        for (size_t i = 0; i < SELFTEST_SINE_STEPS; i++)
+            phase[i] = (float)turn + (float)i / SELFTEST_SINE_STEPS;
+        if (dsp != NULL)
+            dsp->wave[WaveSin][AliasPolyBlep](phase, phase_dt, 0.0f, out,
+                                              SELFTEST_SINE_STEPS);
+        else
+            for (size_t i = 0; i < SELFTEST_SINE_STEPS; i++)
+                out[i] = sinf(2.0f * PI * phase[i]);
+        for (size_t i = 0; i < SELFTEST_SINE_STEPS; i++)
+        {
+            const double e = fabs(out[i] - sin(SELFTEST_TWO_PI * phase[i]));
+            error = (e <= error) ? error : e;
+        }
+    }
+    return error;
+}
 
-        for (size_t osc_i = 0; osc_i < osc_array->count; osc_i++)
+// Largest error of the scalar rounded-square kernel against rsqShape, over
+// one turn at several shape settings.
+static double selfTestRsq(void)
+{
+    static float phase[SELFTEST_SINE_STEPS], out[SELFTEST_SINE_STEPS];
+    static float phase_dt[SELFTEST_SINE_STEPS]; // unused by the shape
+    for (size_t i = 0; i < SELFTEST_SINE_STEPS; i++)
+        phase[i] = (float)i / SELFTEST_SINE_STEPS;
+    double error = 0.0;
+    for (int step = 0; step <= 4; step++)
+    {
+        const float shape_parm = 0.25f * (float)step;
+        dsp_kernels_scalar.wave[WaveRsq][AliasPolyBlep](
+            phase, phase_dt, shape_parm, out, SELFTEST_SINE_STEPS);
+        for (size_t i = 0; i < SELFTEST_SINE_STEPS; i++)
         {
-            Oscillator *osc = &osc_array->osc[osc_i];
-            if (osc->ui_id == mod_pair->mod_id)
-            {
-                if (mod_pair->modulator == 0)
-                    mod_pair->modulator = osc;
-                osc->is_mod = true;
-            }
+            const double e = fabs(out[i] - rsqShape(phase[i], shape_parm));
+            error = (e <= error) ? error : e;
+        }
+    }
+    return error;
+}
+
+static bool reportSelfTest(const char *build, const char *check, float diff)
+{
+    const bool is_ok = diff == 0.0f;
+    printf("%-7s %-10s max diff %g%s\n", build, check, diff,
+           is_ok ? "" : "  FAILED");
+    return is_ok;
+}
+
+int runSelfTest(void)
+{
+    initWaveTables();
+    initMinBlepTable();
+
+    size_t failures = 0;
+    const double sine_error = selfTestSine(&dsp_kernels_scalar);
+    const bool is_sine_ok = sine_error <= SELFTEST_SINE_MAX_ERROR;
+    printf("sine error %.3g (%.1f dB), sinf(2 * PI * p) %.3g%s\n", sine_error,
+           20.0 * log10(sine_error), selfTestSine(NULL),
+           is_sine_ok ? "" : "  FAILED");
+    failures += !is_sine_ok;
+    const double rsq_error = selfTestRsq();
+    const bool is_rsq_ok = rsq_error <= SELFTEST_RSQ_MAX_ERROR;
+    printf("rounded square error %.3g against powf%s\n", rsq_error,
+           is_rsq_ok ? "" : "  FAILED");
+    failures += !is_rsq_ok;
+
+    for (size_t i = 0; i < DSP_KERNEL_BUILDS_LENGTH; i++)
+    {
+        const DspKernels *dsp = DSP_KERNEL_BUILDS[i];
+        if (dsp == &dsp_kernels_scalar)
+            continue;
+        if (!isDspKernelsSupported(dsp))
+        {
+            printf("%-7s not supported by this CPU, skipped\n", dsp->name);
+            continue;
         }
+        uint32_t seed = 1;
+        failures += !reportSelfTest(dsp->name, "waves",
+                                    selfTestWaves(dsp, &seed));
+        failures += !reportSelfTest(dsp->name, "mix",
+                                    selfTestMix(dsp, &seed));
+        failures += !reportSelfTest(dsp->name, "envelopes",
+                                    selfTestEnvelopes(dsp, &seed));
+        failures += !reportSelfTest(dsp->name, "voices",
+                                    selfTestVoices(dsp, &seed));
+    }
+    if (failures > 0)
+        printf("%zu checks FAILED against the scalar build\n", failures);
+    else
+        printf("All kernel builds match the scalar build\n");
+    return (failures > 0) ? 1 : 0;
+}
+
+////////////////////////////////////////////////////////////////
+
+// --bench: cost per sample of the PolyBLEP saw and square kernels of each
+// build, against the per-sample if/else form they replaced, at a low and a
+// high pitch. Each time is the best of BENCH_REPEATS runs over one slice.
+#define BENCH_FRAMES MAX_SLICE_SIZE
+#define BENCH_SLICES 20000
+#define BENCH_REPEATS 5
+#define BENCH_LOW_DT 0.01f // 480 Hz at 48 kHz
+#define BENCH_HIGH_DT 0.1f // 4.8 kHz
+
+static void branchySawKernel(const float *phase, const float *phase_dt,
+                             float shape_parm, float *out, size_t frames)
+{
+    for (size_t t = 0; t < frames; t++)
+        out[t] = ((phase[t] * 2.0f) - 1.0f) -
+                 bandLimitedRippleFx(phase[t], phase_dt[t]);
+}
+
+static void branchySqrKernel(const float *phase, const float *phase_dt,
+                             float shape_parm, float *out, size_t frames)
+{
+    for (size_t t = 0; t < frames; t++)
+    {
+        float sample = (phase[t] < shape_parm) ? 1.0f : -1.0f;
+        sample += bandLimitedRippleFx(phase[t], phase_dt[t]);
+        sample -= bandLimitedRippleFx(
+            fmodf(phase[t] + (1.0f - shape_parm), 1.0f), phase_dt[t]);
+        out[t] = sample;
+    }
+}
+
+// Nanoseconds per sample of `kernel` at a constant increment.
+static double benchKernel(WaveKernelFn kernel, float increment)
+{
+    float phase[BENCH_FRAMES], phase_dt[BENCH_FRAMES], out[BENCH_FRAMES];
+    for (size_t t = 0; t < BENCH_FRAMES; t++)
+    {
+        phase[t] = fmodf((float)(t + 1) * increment, 1.0f);
+        phase_dt[t] = increment;
+    }
+    double best = INFINITY;
+    for (int repeat = 0; repeat < BENCH_REPEATS; repeat++)
+    {
+        const double start = nowSeconds();
+        for (int slice = 0; slice < BENCH_SLICES; slice++)
+            kernel(phase, phase_dt, 0.3f, out, BENCH_FRAMES);
+        const double elapsed = nowSeconds() - start;
+        best = (elapsed < best) ? elapsed : best;
+    }
+    return best * 1e9 / ((double)BENCH_SLICES * BENCH_FRAMES);
+}
+
+// Saw then square, each at BENCH_LOW_DT and BENCH_HIGH_DT.
+static void benchSawSqr(WaveKernelFn saw, WaveKernelFn sqr, double *ns)
+{
+    ns[0] = benchKernel(saw, BENCH_LOW_DT);
+    ns[1] = benchKernel(saw, BENCH_HIGH_DT);
+    ns[2] = benchKernel(sqr, BENCH_LOW_DT);
+    ns[3] = benchKernel(sqr, BENCH_HIGH_DT);
+}
+
+static void printBenchRow(const char *name, const double *ns,
+                          const double *baseline)
+{
+    printf("%-8s", name);
+    for (int i = 0; i < 4; i++)
+        printf(" %6.2f (%4.1fx)", ns[i], baseline[i] / ns[i]);
+    printf("\n");
+}
+
+int runBenchmark(void)
+{
+    printf("PolyBLEP, ns per sample in %d-sample slices (speedup over "
+           "if/else)\n",
+           BENCH_FRAMES);
+    printf("%-8s %14s %14s %14s %14s\n", "", "saw dt 0.01", "saw dt 0.1",
+           "square dt 0.01", "square dt 0.1");
+
+    double baseline[4];
+    benchSawSqr(branchySawKernel, branchySqrKernel, baseline);
+    printBenchRow("if/else", baseline, baseline);
+    for (size_t i = 0; i < DSP_KERNEL_BUILDS_LENGTH; i++)
+    {
+        const DspKernels *dsp = DSP_KERNEL_BUILDS[i];
+        if (!isDspKernelsSupported(dsp))
+            continue;
+        double ns[4];
+        benchSawSqr(dsp->wave[WaveSaw][AliasPolyBlep],
+                    dsp->wave[WaveSqr][AliasPolyBlep], ns);
+        printBenchRow(dsp->name, ns, baseline);
+    }
+    return 0;
+}
+
+// A count option's value: a whole number, 0 or more. Says why on failure.
+bool parseCountArg(const char *option, const char *value, size_t *count)
+{
+    char *end;
+    errno = 0;
+    const long parsed = strtol(value, &end, 10);
+    if (end == value || *end != '\0' || errno == ERANGE || parsed < 0)
+    {
+        fprintf(stderr, "%s takes a whole number of 0 or more, not '%s'\n",
+                option, value);
+        return false;
     }
+    *count = (size_t)parsed;
+    return true;
 }
 
-int main()
+int main(int argc, char **argv)
 {
+    EngineMode engine_mode = EnginePush;
+    EngineConfig config = ENGINE_PRESETS[0].config;
+    const char **render_args = NULL;
+    bool is_self_test = false;
+    bool is_bench = false;
+
+    // The preset goes first, so explicit --rate, --block and --slice win
+    // wherever they appear.
+    for (int arg_i = 1; arg_i + 1 < argc; arg_i++)
+    {
+        if (strcmp(argv[arg_i], "--preset") != 0)
+            continue;
+        const char *name = argv[++arg_i];
+        size_t preset_i = 0;
+        while (preset_i < ENGINE_PRESETS_LENGTH &&
+               strcmp(name, ENGINE_PRESETS[preset_i].name) != 0)
+            preset_i++;
+        if (preset_i == ENGINE_PRESETS_LENGTH)
+        {
+            fprintf(stderr, "Unknown preset '%s'\n", name);
+            return 1;
+        }
+        const EngineConfig *preset = &ENGINE_PRESETS[preset_i].config;
+        config.sample_rate = preset->sample_rate;
+        config.block_size = preset->block_size;
+        config.slice_size = preset->slice_size;
+    }
+
+    for (int arg_i = 1; arg_i < argc; arg_i++)
+    {
+        const bool has_value = arg_i + 1 < argc;
+        if (strcmp(argv[arg_i], "--pull") == 0)
+            engine_mode = EnginePull;
+        else if (strcmp(argv[arg_i], "--push") == 0)
+            engine_mode = EnginePush;
+        else if (strcmp(argv[arg_i], "--rate") == 0 && has_value)
+            config.sample_rate = atoi(argv[++arg_i]);
+        else if (strcmp(argv[arg_i], "--block") == 0 && has_value)
+        {
+            if (!parseCountArg("--block", argv[++arg_i], &config.block_size))
+                return 1;
+        }
+        else if (strcmp(argv[arg_i], "--slice") == 0 && has_value)
+        {
+            if (!parseCountArg("--slice", argv[++arg_i], &config.slice_size))
+                return 1;
+        }
+        else if (strcmp(argv[arg_i], "--threads") == 0 && has_value)
+        {
+            if (!parseCountArg("--threads", argv[++arg_i],
+                               &config.render_threads))
+                return 1;
+        }
+        else if (strcmp(argv[arg_i], "--rt") == 0)
+            config.is_rt_priority_requested = true;
+        else if (strcmp(argv[arg_i], "--fixed-phase") == 0)
+            config.is_fixed_phase = true;
+        else if (strcmp(argv[arg_i], "--kernels") == 0 && has_value)
+            config.kernels = argv[++arg_i];
+        else if (strcmp(argv[arg_i], "--cull") == 0 && has_value)
+        {
+            // At 0 dBFS or above every voice would be culled.
+            config.cull_db = (float)atof(argv[++arg_i]);
+            if (!(config.cull_db < 0.0f))
+            {
+                fprintf(stderr,
+                        "--cull takes a level below 0 dBFS, or -inf to "
+                        "turn culling off\n");
+                return 1;
+            }
+        }
+        else if (strcmp(argv[arg_i], "--voices") == 0 && has_value)
+        {
+            if (!parseCountArg("--voices", argv[++arg_i], &config.polyphony))
+                return 1;
+        }
+        else if (strcmp(argv[arg_i], "--steal") == 0 && has_value)
+        {
+            const char *name = argv[++arg_i];
+            int policy = 0;
+            while (policy < StealPolicyCount &&
+                   strcmp(name, STEAL_POLICY_NAMES[policy]) != 0)
+                policy++;
+            if (policy == StealPolicyCount)
+            {
+                fprintf(stderr, "Unknown steal policy '%s'\n", name);
+                return 1;
+            }
+            config.steal_policy = (StealPolicy)policy;
+        }
+        else if (strcmp(argv[arg_i], "--preset") == 0 && has_value)
+            arg_i++; // applied above
+        else if (strcmp(argv[arg_i], "--render") == 0)
+        {
+            if (arg_i + 3 >= argc)
+            {
+                fprintf(stderr,
+                        "usage: %s --render <patch> <notes> <out.wav>\n",
+                        argv[0]);
+                return 1;
+            }
+            render_args = (const char **)argv + arg_i + 1;
+            arg_i += 3;
+        }
+        else if (strcmp(argv[arg_i], "--selftest") == 0)
+            is_self_test = true;
+        else if (strcmp(argv[arg_i], "--bench") == 0)
+            is_bench = true;
+    }
+
+    if (is_self_test)
+        return runSelfTest();
+    if (is_bench)
+        return runBenchmark();
+
+    if (config.sample_rate < 8000 || config.sample_rate > 192000 ||
+        config.block_size < MIN_BLOCK_SIZE ||
+        config.block_size > MAX_BLOCK_SIZE || config.slice_size == 0 ||
+        config.slice_size > MAX_SLICE_SIZE)
+    {
+        fprintf(stderr,
+                "Unsupported sample rate %d / block size %zu / slice size "
+                "%zu\n",
+                config.sample_rate, config.block_size, config.slice_size);
+        return 1;
+    }
+
+    if (selectDspKernels(config.kernels) == NULL)
+    {
+        fprintf(stderr, "Kernels '%s' unknown or not supported by this CPU\n",
+                config.kernels);
+        return 1;
+    }
+
+    if (render_args != NULL)
+        return renderHeadless(config, render_args[0], render_args[1],
+                              render_args[2]);
+
     InitWindow(SCREEN_WIDTH, SCREEN_HEIGHT, "Simple Synth");
     SetTargetFPS(120);
     InitAudioDevice();
 
     GuiLoadStyle("./cyber/cyber.rgs");
 
-    SetAudioStreamBufferSizeDefault(STREAM_BUFFER_SIZE);
+    SetAudioStreamBufferSizeDefault((int)config.block_size);
     AudioStream synth_stream =
-        LoadAudioStream(SAMPLE_RATE, sizeof(float) * 8, 1);
+        LoadAudioStream(config.sample_rate, sizeof(float) * 8, 1);
     SetAudioStreamVolume(synth_stream, 0.05f);
-    PlayAudioStream(synth_stream);
 
     // Oscillator sinOsc[NUM_OSCILLATORS] = {0};
     // Oscillator sawOsc[NUM_OSCILLATORS] = {0};
@@ -608,30 +4485,33 @@ int main()
     // Oscillator rsqOsc[NUM_OSCILLATORS] = {0};
 
     ModulationPair mod_pairs[256] = {0};
-    float signal[STREAM_BUFFER_SIZE] = {0};
-
-    Synth *synth = (Synth *)malloc(sizeof(Synth));
-
-    synth->osc_groups_count = WaveCount;
-    synth->signal = signal;
-    synth->signal_length = STREAM_BUFFER_SIZE;
 
-    synth->osc_groups[WaveSin].count = 0;
-    synth->osc_groups[WaveSaw].count = 0;
-    synth->osc_groups[WaveTri].count = 0;
-    synth->osc_groups[WaveSqr].count = 0;
-    synth->osc_groups[WaveRsq].count = 0;
-    synth->osc_groups[WaveSin].shape_fn = sinShape;
-    synth->osc_groups[WaveSaw].shape_fn = sawShape;
-    synth->osc_groups[WaveTri].shape_fn = triShape;
-    synth->osc_groups[WaveSqr].shape_fn = sqrShape;
-    synth->osc_groups[WaveRsq].shape_fn = rsqShape;
+    Synth *synth = createSynth(engine_mode, config);
+    lockEngineMemory(synth);
 
-    synth->mod_pair_array.count = 0;
+    if (synth->engine_mode == EnginePull)
+    {
+        audio_callback_synth = synth;
+        SetAudioStreamCallback(synth_stream, audioStreamCallback);
+    }
+    else
+    {
+        prepareRenderThread(synth);
+    }
+    PlayAudioStream(synth_stream);
 
     while (!WindowShouldClose())
     {
-        handleAudioStream(synth_stream, synth);
+        if (synth->engine_mode == EnginePush)
+            handleAudioStream(synth_stream, synth);
+
+        if (!synth->is_rt_status_reported &&
+            atomic_load_explicit(&synth->is_rt_status_ready,
+                                 memory_order_acquire))
+        {
+            printRtStatus(synth);
+            synth->is_rt_status_reported = true;
+        }
 
         BeginDrawing();
         ClearBackground(BLACK);
@@ -641,11 +4521,12 @@ int main()
         drawSignal(synth);
 
         DrawText(TextFormat("Fundamental freq: %.1f",
-                            synth->osc_groups[0].osc[0].freq),
+                            uiFundamentalFreq(synth)),
                  LEFT_PANEL_WIDTH + 10, 30, 20, RED);
 
         DrawText(TextFormat("FPS: %i, delta: %f", GetFPS(), GetFrameTime()),
                  LEFT_PANEL_WIDTH + 10, 50, 16, RED);
+        drawAudioStats(synth);
 
         EndDrawing();
     }
@@ -653,6 +4534,7 @@ int main()
     UnloadAudioStream(synth_stream);
     CloseAudioDevice();
     CloseWindow();
+    destroySynth(synth);
 
     return 0;
 }
\ No newline at end of file
@@ -1,5 +1,6 @@
 #!/bin/bash
 
-# Compile and run the program
-cc main.c -o bin/synth -lraylib -lm
-bin/synth
\ No newline at end of file
+# Compile, check the kernel builds against the scalar one, and run the program
+cc -O2 -ffp-contract=off main.c -o bin/synth -lraylib -lm -lpthread
+bin/synth --selftest || exit 1
+bin/synth